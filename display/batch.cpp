@@ -0,0 +1,594 @@
+// Headless batch renderer: renders every frame of the weight sequences
+// into an offscreen framebuffer, with no window, timer or vsync, and
+// writes them as PPM images, as a raw RGB stream or as a video.
+//
+//   ./display/batch [-o prefix | -r | -e video | -p file] [-s WxH] [-n frames] [-f fps] [-F filter] [-g] [-j jobs]
+//
+//   -o prefix  write prefix00000.ppm, prefix00001.ppm, ...
+//   -r         write raw rgb24 frames to stdout, e.g. piped into
+//              ffmpeg -f rawvideo -pix_fmt rgb24 -s 1024x768 -r 100 -i -
+//   -e video   encode with ffmpeg, muxing in the voice at the time main
+//              plays it (-a wav, default input_voice/microphone-result.wav,
+//              or -A for no audio)
+//   -p file    pack the sequence files into file (sequence.bin, see
+//              sequence.h) and exit
+//   -s WxH     frame size (default 1024x768, the window size of main)
+//   -n frames  stop after this many frames
+//   -f fps     frame rate (default 100, the rate of the text tracks);
+//              other rates interpolate the tracks between their samples
+//   -F filter  smoothing of raw packed tracks (see flParse(), default
+//              flat, the smoothing of the model, or none)
+//   -g         blend in the vertex shader (morph.h)
+//   -m heads   draw a crowd of this many heads (with -g), each a
+//              different point of the clip
+//   -c         render with the software rasterizer (raster.h), no GL
+//   -w         overlay the wireframe (with -g or -c)
+//   -t threads threads for -c (default one per processor, or shared
+//              out between the jobs of -j)
+//   -j jobs    render in this many processes (0 for one per
+//              processor), each a contiguous run of the frames with its
+//              own context; with -o or no output
+//
+// Runs from the repository root like main, reading ./data/head.obj and
+// the sequence files. The frame rate is printed to stderr.
+//
+// Every frame is evaluated from its number alone, never from the clock
+// or the frame before it, so the output is the same however the frames
+// are shared out between jobs and however long they take.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <algorithm>
+#include <vector>
+
+#include "glm.h"
+#include "blend.h"
+#include "morph.h"
+#include "raster.h"
+#include "sequence.h"
+#include "pca.h"
+
+using namespace std;
+
+// same gains as ref1..ref4 in main.cpp
+GLfloat gains[4] = { 5, 5, 14, -5 };
+
+int width = 1024, height = 768;
+
+// output frame rate, the rate of the tracks unless -f is given
+double fps = 0;
+
+// the camera of main.cpp without the trackball, column major
+GLfloat projection[16], modelview[16];
+
+// gluPerspective(45, aspect, 1, 128) and glTranslatef(0, 0, -3.5)
+void InitMatrices()
+{
+	GLfloat f = 1.0 / tan(45.0 / 2.0 * M_PI / 180.0);
+	GLfloat near = 1.0, far = 128.0;
+
+	memset(projection, 0, sizeof(projection));
+	projection[0] = f * height / width;
+	projection[5] = f;
+	projection[10] = (far + near) / (near - far);
+	projection[11] = -1.0;
+	projection[14] = 2.0 * far * near / (near - far);
+
+	memset(modelview, 0, sizeof(modelview));
+	modelview[0] = modelview[5] = modelview[10] = modelview[15] = 1.0;
+	modelview[14] = -3.5;
+}
+
+// create a GL context with no surface and an offscreen framebuffer to
+// render into
+bool InitContext()
+{
+	EGLDisplay display = EGL_NO_DISPLAY;
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay)
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+	{
+		fputs("Couldn't initialize EGL\n", stderr);
+		return false;
+	}
+	eglBindAPI(EGL_OPENGL_API);
+
+	EGLint attributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLConfig config;
+	EGLint numconfigs = 0;
+	eglChooseConfig(display, attributes, &config, 1, &numconfigs);
+
+	// surfaceless contexts don't need a config (EGL_KHR_no_config_context)
+	EGLContext context = eglCreateContext(display, numconfigs ? config : (EGLConfig)0, EGL_NO_CONTEXT, NULL);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+	{
+		fprintf(stderr, "Couldn't create a GL context. %x\n", eglGetError());
+		return false;
+	}
+
+	GLuint framebuffer, renderbuffers[2];
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glGenRenderbuffers(2, renderbuffers);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		fputs("Couldn't create the offscreen framebuffer\n", stderr);
+		return false;
+	}
+
+	fprintf(stderr, "GL: %s, %s\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+	return true;
+}
+
+// the light and state of main.cpp
+void InitView()
+{
+	GLfloat light_ambient[] = { 0.0, 0.0, 0.0, 1.0 };
+	GLfloat light_diffuse[] = { 0.8, 0.8, 0.8, 1.0 };
+	GLfloat light_specular[] = { 1.0, 1.0, 1.0, 1.0 };
+	GLfloat light_position[] = { 0.0, 0.0, 1.0, 0.0 };
+
+	glViewport(0, 0, width, height);
+	glMatrixMode(GL_PROJECTION);
+	glLoadMatrixf(projection);
+	glMatrixMode(GL_MODELVIEW);
+	glLoadMatrixf(modelview);
+
+	glLightfv(GL_LIGHT0, GL_AMBIENT, light_ambient);
+	glLightfv(GL_LIGHT0, GL_DIFFUSE, light_diffuse);
+	glLightfv(GL_LIGHT0, GL_SPECULAR, light_specular);
+	glLightfv(GL_LIGHT0, GL_POSITION, light_position);
+
+	glClearColor(0, 0, 0, 0);
+	glEnable(GL_LIGHT0);
+	glDepthFunc(GL_LESS);
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_LIGHTING);
+	glEnable(GL_COLOR_MATERIAL);
+	glColor3f(1.0, 1.0, 1.0f);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+}
+
+// write one frame, flipping the bottom-up GL rows
+bool WriteFrame(FILE *out, const unsigned char *pixels)
+{
+	int row = width * 3;
+	for (int y = height - 1; y >= 0; y--)
+		if (fwrite(pixels + y * row, 1, row, out) != (size_t)row)
+			return false;
+	return true;
+}
+
+// destinations of the frames
+const char *prefix = NULL;
+bool raw = false;
+FILE *encoder = NULL;
+
+bool OutputFrame(unsigned int frame, const unsigned char *pixels)
+{
+	if (raw && !WriteFrame(stdout, pixels))
+	{
+		fputs("Error writing to stdout\n", stderr);
+		return false;
+	}
+	if (encoder && !WriteFrame(encoder, pixels))
+	{
+		fputs("Error writing to the encoder\n", stderr);
+		return false;
+	}
+	if (prefix)
+	{
+		char filename[1024];
+		sprintf(filename, "%s%05u.ppm", prefix, frame);
+		FILE *out = fopen(filename, "wb");
+		if (out == NULL)
+		{
+			perror(filename);
+			return false;
+		}
+		fprintf(out, "P6\n%d %d\n255\n", width, height);
+		bool written = WriteFrame(out, pixels);
+		fclose(out);
+		if (!written)
+		{
+			perror(filename);
+			return false;
+		}
+	}
+	return true;
+}
+
+// frames are read back into a ring of pixel buffers and written
+// READBACK_BUFFERS - 1 frames later, when the copy has long finished
+#define READBACK_BUFFERS 3
+GLuint readback[READBACK_BUFFERS];
+
+bool OutputReadback(unsigned int frame)
+{
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readback[frame % READBACK_BUFFERS]);
+	const unsigned char *pixels = (const unsigned char *)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+	bool written = pixels && OutputFrame(frame, pixels);
+	if (pixels)
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	return written;
+}
+
+// start ffmpeg on raw frames at the output rate, with the voice
+// placed where main starts playing it on the timeline; the paths go
+// to ffmpeg as they are, with no shell in between
+pid_t encoder_pid = -1;
+
+FILE *OpenEncoder(const char *output, const char *audio)
+{
+	char size[32], rate[32], offset[32];
+	snprintf(size, sizeof(size), "%dx%d", width, height);
+	snprintf(rate, sizeof(rate), "%g", fps);
+	snprintf(offset, sizeof(offset), "%g", SQ_AUDIOSTART / 1000.0);
+
+	vector<const char *> args = { "ffmpeg", "-loglevel", "error", "-y",
+		"-f", "rawvideo", "-pix_fmt", "rgb24", "-s", size, "-framerate", rate, "-i", "-" };
+	FILE *wav = audio ? fopen(audio, "rb") : NULL;
+	if (wav)
+	{
+		fclose(wav);
+		args.insert(args.end(), { "-itsoffset", offset, "-i", audio,
+			"-map", "0:v", "-map", "1:a", "-c:a", "aac" });
+	}
+	else if (audio)
+		fprintf(stderr, "Couldn't open %s, encoding without audio\n", audio);
+	args.insert(args.end(), { "-c:v", "libx264", "-pix_fmt", "yuv420p", output, NULL });
+
+	// report a dead encoder as a write error instead of being killed
+	signal(SIGPIPE, SIG_IGN);
+	int fds[2];
+	if (pipe(fds) < 0)
+	{
+		perror("pipe");
+		return NULL;
+	}
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		dup2(fds[0], STDIN_FILENO);
+		close(fds[0]);
+		close(fds[1]);
+		execvp(args[0], (char *const *)&args[0]);
+		perror("ffmpeg");
+		_exit(127);
+	}
+	close(fds[0]);
+	if (pid < 0)
+	{
+		perror("fork");
+		close(fds[1]);
+		return NULL;
+	}
+	encoder_pid = pid;
+	return fdopen(fds[1], "w");
+}
+
+// close the frames and wait for ffmpeg; false if it failed
+bool CloseEncoder(FILE *encoder)
+{
+	bool closed = fclose(encoder) == 0;
+	int status;
+	if (waitpid(encoder_pid, &status, 0) < 0)
+		return false;
+	return closed && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// fork a process per job; returns the job number in each child, or -1
+// in the parent once they have all exited, with whether any failed
+int ForkJobs(unsigned int jobs, bool *failed)
+{
+	*failed = false;
+	fflush(NULL);
+	unsigned int started = 0;
+	for (; started < jobs; started++)
+	{
+		pid_t pid = fork();
+		if (pid == 0)
+			return started;
+		if (pid < 0)
+		{
+			perror("fork");
+			*failed = true;
+			break;
+		}
+	}
+
+	int status;
+	for (unsigned int i = 0; i < started; i++)
+		if (wait(&status) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			*failed = true;
+	return -1;
+}
+
+double Seconds()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *output = NULL, *audio = "input_voice/microphone-result.wav";
+	const char *pack = NULL, *filter_spec = "flat";
+	bool gpu_morph = false, software = false, wireframe = false;
+	unsigned int maxframes = (unsigned int)-1, numthreads = 0, numheads = 0, jobs = 1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-o") && i + 1 < argc)
+			prefix = argv[++i];
+		else if (!strcmp(argv[i], "-r"))
+			raw = true;
+		else if (!strcmp(argv[i], "-e") && i + 1 < argc)
+			output = argv[++i];
+		else if (!strcmp(argv[i], "-p") && i + 1 < argc)
+			pack = argv[++i];
+		else if (!strcmp(argv[i], "-a") && i + 1 < argc)
+			audio = argv[++i];
+		else if (!strcmp(argv[i], "-A"))
+			audio = NULL;
+		else if (!strcmp(argv[i], "-s") && i + 1 < argc && sscanf(argv[i + 1], "%dx%d", &width, &height) == 2)
+			i++;
+		else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+			maxframes = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-f") && i + 1 < argc && (fps = atof(argv[i + 1])) > 0)
+			i++;
+		else if (!strcmp(argv[i], "-F") && i + 1 < argc)
+			filter_spec = argv[++i];
+		else if (!strcmp(argv[i], "-g"))
+			gpu_morph = true;
+		else if (!strcmp(argv[i], "-m") && i + 1 < argc)
+			numheads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-c"))
+			software = true;
+		else if (!strcmp(argv[i], "-w"))
+			wireframe = true;
+		else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+			numthreads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+			jobs = atoi(argv[++i]);
+		else
+		{
+			fprintf(stderr, "usage: %s [-o prefix | -r | -e video [-a wav | -A] | -p file] [-s WxH] [-n frames] [-f fps] [-F filter] [-g [-m heads] | -c [-t threads]] [-w] [-j jobs]\n", argv[0]);
+			return 1;
+		}
+	}
+	// the streams take the frames in order, from one process
+	if (jobs != 1 && (raw || output))
+	{
+		fputs("-j writes frames with -o only\n", stderr);
+		return 1;
+	}
+	long processors = sysconf(_SC_NPROCESSORS_ONLN);
+	if (jobs == 0)
+		jobs = processors > 0 ? processors : 1;
+
+	SQtracks *tracks = sqRead(".");
+	if (!tracks || tracks->numselected < 4)
+	{
+		fputs("Couldn't read the weight sequences\n", stderr);
+		return 1;
+	}
+	if (!sqFilter(tracks, filter_spec))
+		return 1;
+	if (pack)
+		return sqWrite(tracks, pack) ? 0 : 1;
+	if (fps <= 0)
+		fps = 1000.0 / SQ_FRAMETIME;
+
+	// up to the last sample of the tracks
+	unsigned int numframes = (unsigned int)((tracks->numframes - 1) * tracks->frametime * fps / 1000.0) + 1;
+	if (numframes > maxframes)
+		numframes = maxframes;
+
+	// the frames of this process; each job renders a contiguous run
+	unsigned int first = 0, last = numframes;
+	if (jobs > 1)
+	{
+		double start = Seconds();
+		bool failed;
+		int job = ForkJobs(jobs, &failed);
+		if (job < 0)
+		{
+			double elapsed = Seconds() - start;
+			if (!failed)
+				fprintf(stderr, "%u frames in %u jobs in %.3f s: %.1f fps\n", numframes, jobs,
+					elapsed, elapsed > 0 ? numframes / elapsed : 0.0);
+			return failed ? 1 : 0;
+		}
+		first = (unsigned long long)numframes * job / jobs;
+		last = (unsigned long long)numframes * (job + 1) / jobs;
+		if (numthreads == 0)
+			numthreads = max(1L, processors / (long)jobs);
+	}
+
+	InitMatrices();
+	SRcontext *raster = NULL;
+	if (software)
+	{
+		raster = srCreate(width, height, numthreads);
+		memcpy(raster->projection, projection, sizeof(projection));
+		memcpy(raster->modelview, modelview, sizeof(modelview));
+		raster->linewidth = wireframe ? 1.0 : 0.0;
+		fprintf(stderr, "software rasterizer, %u threads\n", raster->numthreads);
+	}
+	else
+	{
+		if (!InitContext())
+			return 1;
+		InitView();
+
+		glGenBuffers(READBACK_BUFFERS, readback);
+		for (int i = 0; i < READBACK_BUFFERS; i++)
+		{
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, readback[i]);
+			glBufferData(GL_PIXEL_PACK_BUFFER, width * height * 3, NULL, GL_STREAM_READ);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+
+	if (output && (encoder = OpenEncoder(output, audio)) == NULL)
+		return 1;
+
+	GLMmodel *mesh = glmReadOBJ("./data/head.obj", NULL, GL_TRUE);
+	glmUnitize(mesh);
+	glmFacetNormals(mesh);
+	glmVertexNormals(mesh, 90.0);
+
+	BSbasis *basis = bsCreate(mesh->numvertices, mean_shape, 1.0 / 30);
+	bsAddComponent(basis, pca_str1);
+	bsAddComponent(basis, pca_str2);
+	bsAddComponent(basis, pca_str3);
+	bsAddComponent(basis, pca_str4);
+	bsUnitize(basis);
+	bsNormalBasis(basis, mesh);
+	GLMindexed *indexed = glmIndexed(mesh, GLM_SMOOTH);
+	GLMbuffers *buffers = software ? NULL : glmBuffers(indexed);
+	MTshader *morph = gpu_morph && !software ? mtCreate(basis, indexed) : NULL;
+	if (gpu_morph && !software && !morph)
+		return 1;
+	if (morph)
+		morph->linewidth = wireframe ? 1.0 : 0.0;
+	MTcrowd *crowd = NULL;
+	vector<GLfloat> transforms(16 * numheads), crowd_weights(4 * numheads);
+	if (morph && numheads > 0)
+	{
+		if ((crowd = mtCrowdCreate(morph)) == NULL)
+			return 1;
+		mtCrowdGrid(numheads, &transforms[0]);
+		fprintf(stderr, "crowd of %u heads, %s draws\n", numheads,
+			crowd->instanced ? "instanced" : "per-head");
+	}
+
+	GLfloat weights[4];
+
+	double start = Seconds(), shortest = 1e30, longest = 0;
+	for (unsigned int frame = first; frame < last; frame++)
+	{
+		double frame_start = Seconds();
+		double position = frame * 1000.0 / fps / tracks->frametime;
+		sqWeightsAt(tracks, position, gains, weights);
+
+		if (crowd)
+		{
+			for (unsigned int i = 0; i < numheads; i++)
+				sqWeightsAt(tracks, fmod(position + (double)i * tracks->numframes / numheads,
+					tracks->numframes), gains, &crowd_weights[4 * i]);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			mtCrowdDraw(crowd, numheads, &transforms[0], &crowd_weights[0]);
+		}
+		else if (morph)
+		{
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			mtDraw(morph, weights);
+		}
+		else
+		{
+			bsBlend(basis, weights, &mesh->vertices[3]);
+			bsBlendNormals(basis, weights, mesh);
+			glmIndexedUpdate(indexed, mesh);
+			if (raster)
+			{
+				srClear(raster);
+				srDraw(raster, indexed);
+			}
+			else
+			{
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				glmBuffersUpdate(buffers, indexed);
+				glmDrawBuffers(buffers);
+			}
+		}
+
+		// mapping an older readback waits for that frame, so the timing
+		// covers the rendering even when nothing is written
+		bool written = true;
+		if (raster)
+			written = OutputFrame(frame, raster->color);
+		else
+		{
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, readback[frame % READBACK_BUFFERS]);
+			glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, (GLvoid *)0);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			if (frame >= first + READBACK_BUFFERS - 1)
+				written = OutputReadback(frame - (READBACK_BUFFERS - 1));
+		}
+		if (!written)
+			return 1;
+
+		double frame_time = Seconds() - frame_start;
+		shortest = min(shortest, frame_time);
+		longest = max(longest, frame_time);
+	}
+
+	// the frames still in flight
+	if (!raster)
+	{
+		unsigned int flight = last - first > READBACK_BUFFERS - 1 ? last - (READBACK_BUFFERS - 1) : first;
+		for (unsigned int frame = flight; frame < last; frame++)
+			if (!OutputReadback(frame))
+				return 1;
+	}
+	double elapsed = Seconds() - start;
+
+	if (encoder && !CloseEncoder(encoder))
+	{
+		fputs("The encoder failed\n", stderr);
+		return 1;
+	}
+	double encoded = Seconds() - start;
+
+	unsigned int rendered = last - first;
+	fprintf(stderr, "%u frames of %dx%d in %.3f s: %.1f fps\n", rendered, width, height,
+		elapsed, elapsed > 0 ? rendered / elapsed : 0.0);
+	if (rendered > 0)
+		fprintf(stderr, "frame time: min %.2f mean %.2f max %.2f ms\n", shortest * 1e3,
+			elapsed * 1e3 / rendered, longest * 1e3);
+	if (encoder)
+		fprintf(stderr, "encoded %.3f s of animation in %.3f s (%.1fx real time)\n",
+			rendered / fps, encoded, encoded > 0 ? rendered / fps / encoded : 0.0);
+
+	if (crowd)
+		mtCrowdDelete(crowd);
+	if (morph)
+		mtDelete(morph);
+	if (buffers)
+		glmBuffersDelete(buffers);
+	if (raster)
+		srDelete(raster);
+	else
+		glDeleteBuffers(READBACK_BUFFERS, readback);
+	glmIndexedDelete(indexed);
+	bsDelete(basis);
+	glmDelete(mesh);
+	sqDelete(tracks);
+
+	return 0;
+}
@@ -0,0 +1,370 @@
+/*
+      blend.cpp
+
+      Blendshape (PCA) evaluation for the animated head.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "blend.h"
+
+
+#define T(x) (model->triangles[(x)])
+
+
+/* bsKernel: out = scale * (base + sum(weights[k] * deltas[k])) - center,
+ * the blend used for both positions and normals
+ *
+ * center - 3 GLfloats
+ * count  - number of vectors (3 GLfloats) in each array
+ */
+static GLvoid
+bsKernel(GLfloat* base, GLfloat** deltas, GLuint numdeltas, GLfloat* weights,
+         GLfloat scale, GLfloat* center, GLuint count, GLfloat* out)
+{
+    GLuint i, j, k;
+    GLfloat sum;
+
+    for (i = 0; i < 3 * count; i += 3) {
+        for (j = 0; j < 3; j++) {
+            sum = base[i + j];
+            for (k = 0; k < numdeltas; k++)
+                sum += weights[k] * deltas[k][i + j];
+            out[i + j] = scale * sum - center[j];
+        }
+    }
+}
+
+/* bsAreaNormals: area-weighted (unnormalized) vertex normals
+ *
+ * model     - model providing the triangles
+ * positions - 3 GLfloats per vertex, indexed from 0
+ * normals   - 3 GLfloats per vertex, indexed from 0, to accumulate into
+ */
+static GLvoid
+bsAreaNormals(GLMmodel* model, GLfloat* positions, GLfloat* normals)
+{
+    GLuint i, j;
+    GLfloat* a;
+    GLfloat* b;
+    GLfloat* c;
+    GLfloat u[3], v[3], n[3];
+
+    memset(normals, 0, sizeof(GLfloat) * 3 * model->numvertices);
+    for (i = 0; i < model->numtriangles; i++) {
+        a = &positions[3 * (T(i).vindices[0] - 1)];
+        b = &positions[3 * (T(i).vindices[1] - 1)];
+        c = &positions[3 * (T(i).vindices[2] - 1)];
+        for (j = 0; j < 3; j++) {
+            u[j] = b[j] - a[j];
+            v[j] = c[j] - a[j];
+        }
+        n[0] = u[1] * v[2] - u[2] * v[1];
+        n[1] = u[2] * v[0] - u[0] * v[2];
+        n[2] = u[0] * v[1] - u[1] * v[0];
+        for (j = 0; j < 3; j++) {
+            normals[3 * (T(i).vindices[j] - 1) + 0] += n[0];
+            normals[3 * (T(i).vindices[j] - 1) + 1] += n[1];
+            normals[3 * (T(i).vindices[j] - 1) + 2] += n[2];
+        }
+    }
+}
+
+/* bsNormalize: normalize count vectors in place (zero vectors are left
+ * alone)
+ */
+static GLvoid
+bsNormalize(GLfloat* v, GLuint count)
+{
+    GLuint i;
+    GLfloat l;
+
+    for (i = 0; i < count; i++, v += 3) {
+        l = (GLfloat)sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        if (l > 0.0f) {
+            v[0] /= l;
+            v[1] /= l;
+            v[2] /= l;
+        }
+    }
+}
+
+
+/* public functions */
+
+
+/* bsCreate: Creates a basis around a mean shape.
+ *
+ * numvertices - number of vertices per shape
+ * mean        - array of 3 * numvertices GLfloats
+ * scale       - scale applied to every blended shape
+ */
+BSbasis*
+bsCreate(GLuint numvertices, GLfloat* mean, GLfloat scale)
+{
+    BSbasis* basis;
+    GLuint k;
+
+    assert(mean);
+
+    basis = (BSbasis*)malloc(sizeof(BSbasis));
+    basis->numvertices = numvertices;
+    basis->numcomponents = 0;
+    basis->scale = scale;
+    basis->center[0] = basis->center[1] = basis->center[2] = 0.0f;
+    basis->mean = mean;
+    basis->normals = NULL;
+    for (k = 0; k < BS_MAX_COMPONENTS; k++) {
+        basis->components[k] = NULL;
+        basis->normaldeltas[k] = NULL;
+    }
+
+    return basis;
+}
+
+/* bsUnitize: Folds the glmUnitize() transform of the mean shape into
+ * the scale and center of a basis.
+ *
+ * basis - basis created with bsCreate()
+ */
+GLfloat
+bsUnitize(BSbasis* basis)
+{
+    GLfloat mins[3], maxs[3], p, w, h, d, size, unitscale;
+    GLuint i, j;
+
+    assert(basis);
+    assert(basis->numvertices > 0);
+
+    for (j = 0; j < 3; j++)
+        mins[j] = maxs[j] = basis->scale * basis->mean[j] - basis->center[j];
+    for (i = 1; i < basis->numvertices; i++) {
+        for (j = 0; j < 3; j++) {
+            p = basis->scale * basis->mean[3 * i + j] - basis->center[j];
+            if (p < mins[j]) mins[j] = p;
+            if (p > maxs[j]) maxs[j] = p;
+        }
+    }
+
+    /* same (absolute value) extents as glmUnitize() */
+    w = fabs(maxs[0]) + fabs(mins[0]);
+    h = fabs(maxs[1]) + fabs(mins[1]);
+    d = fabs(maxs[2]) + fabs(mins[2]);
+    size = w > h ? w : h;
+    size = size > d ? size : d;
+    unitscale = 2.0f / size;
+
+    /* (scale * p - center - mid) * unitscale */
+    for (j = 0; j < 3; j++)
+        basis->center[j] = (basis->center[j] + (maxs[j] + mins[j]) / 2.0f) * unitscale;
+    basis->scale *= unitscale;
+
+    return unitscale;
+}
+
+/* bsAddComponent: Appends a component to a basis.
+ *
+ * basis     - basis created with bsCreate()
+ * component - array of 3 * numvertices GLfloats
+ */
+GLuint
+bsAddComponent(BSbasis* basis, GLfloat* component)
+{
+    assert(basis);
+    assert(component);
+    assert(basis->numcomponents < BS_MAX_COMPONENTS);
+
+    basis->components[basis->numcomponents] = component;
+    return basis->numcomponents++;
+}
+
+/* bsBlend: Evaluates the shape for a set of weights.
+ *
+ * basis    - basis created with bsCreate()
+ * weights  - array of numcomponents GLfloats
+ * vertices - array of 3 * numvertices GLfloats to write the shape to
+ */
+GLvoid
+bsBlend(BSbasis* basis, GLfloat* weights, GLfloat* vertices)
+{
+    assert(basis);
+    assert(vertices);
+
+    bsKernel(basis->mean, basis->components, basis->numcomponents, weights,
+             basis->scale, basis->center, basis->numvertices, vertices);
+}
+
+/* bsNormalBasis: Precomputes the normal derivatives of every
+ * component around the mean shape.
+ *
+ * The area-weighted normal of a vertex is the sum over its triangles
+ * of (b - a) x (c - a).  Moving every vertex by w * d changes each
+ * term by w * ((b - a) x (dc - da) + (db - da) x (c - a)) plus a w^2
+ * term that is dropped, which is the derivative stored per component.
+ *
+ * basis - basis created with bsCreate()
+ * model - the model the basis animates
+ */
+GLvoid
+bsNormalBasis(BSbasis* basis, GLMmodel* model)
+{
+    GLuint i, j, k, corner[3];
+    GLfloat* m;
+    GLfloat* d;
+    GLfloat* out;
+    GLfloat e1[3], e2[3], d1[3], d2[3], n[3];
+
+    assert(basis);
+    assert(model);
+    assert(model->numvertices == basis->numvertices);
+
+    if (basis->normals)
+        free(basis->normals);
+    basis->normals = (GLfloat*)malloc(sizeof(GLfloat) * 3 * basis->numvertices);
+    bsAreaNormals(model, basis->mean, basis->normals);
+
+    m = basis->mean;
+    for (k = 0; k < basis->numcomponents; k++) {
+        if (basis->normaldeltas[k])
+            free(basis->normaldeltas[k]);
+        out = basis->normaldeltas[k] =
+            (GLfloat*)malloc(sizeof(GLfloat) * 3 * basis->numvertices);
+        memset(out, 0, sizeof(GLfloat) * 3 * basis->numvertices);
+
+        d = basis->components[k];
+        for (i = 0; i < model->numtriangles; i++) {
+            for (j = 0; j < 3; j++)
+                corner[j] = 3 * (T(i).vindices[j] - 1);
+            for (j = 0; j < 3; j++) {
+                e1[j] = m[corner[1] + j] - m[corner[0] + j];
+                e2[j] = m[corner[2] + j] - m[corner[0] + j];
+                d1[j] = d[corner[1] + j] - d[corner[0] + j];
+                d2[j] = d[corner[2] + j] - d[corner[0] + j];
+            }
+            n[0] = e1[1] * d2[2] - e1[2] * d2[1] + d1[1] * e2[2] - d1[2] * e2[1];
+            n[1] = e1[2] * d2[0] - e1[0] * d2[2] + d1[2] * e2[0] - d1[0] * e2[2];
+            n[2] = e1[0] * d2[1] - e1[1] * d2[0] + d1[0] * e2[1] - d1[1] * e2[0];
+            for (j = 0; j < 3; j++) {
+                out[corner[j] + 0] += n[0];
+                out[corner[j] + 1] += n[1];
+                out[corner[j] + 2] += n[2];
+            }
+        }
+    }
+
+    /* one normal per vertex */
+    if (model->normals)
+        glmFree(model, model->normals);
+    model->numnormals = model->numvertices;
+    model->normals = (GLfloat*)glmMalloc(model, sizeof(GLfloat) * 3 * (model->numnormals + 1));
+    memcpy(&model->normals[3], basis->normals, sizeof(GLfloat) * 3 * model->numnormals);
+    bsNormalize(&model->normals[3], model->numnormals);
+    for (i = 0; i < model->numtriangles; i++) {
+        T(i).nindices[0] = T(i).vindices[0];
+        T(i).nindices[1] = T(i).vindices[1];
+        T(i).nindices[2] = T(i).vindices[2];
+    }
+}
+
+/* bsBlendNormals: Evaluates approximate unit normals for a set of
+ * weights into model->normals.
+ *
+ * basis   - basis prepared with bsNormalBasis()
+ * weights - array of numcomponents GLfloats
+ * model   - the model passed to bsNormalBasis()
+ */
+GLvoid
+bsBlendNormals(BSbasis* basis, GLfloat* weights, GLMmodel* model)
+{
+    assert(basis);
+    assert(basis->normals);
+    assert(model);
+    assert(model->numnormals == basis->numvertices);
+
+    bsBlendNormalArray(basis, weights, &model->normals[3]);
+}
+
+/* bsBlendNormalArray: Evaluates the normals of bsBlendNormals() into
+ * an array.
+ *
+ * basis   - basis prepared with bsNormalBasis()
+ * weights - array of numcomponents GLfloats
+ * normals - array of 3 * numvertices GLfloats to write the normals to
+ */
+GLvoid
+bsBlendNormalArray(BSbasis* basis, GLfloat* weights, GLfloat* normals)
+{
+    static GLfloat zero[3] = { 0.0f, 0.0f, 0.0f };
+
+    assert(basis);
+    assert(basis->normals);
+    assert(normals);
+
+    bsKernel(basis->normals, basis->normaldeltas, basis->numcomponents,
+             weights, 1.0f, zero, basis->numvertices, normals);
+    bsNormalize(normals, basis->numvertices);
+}
+
+/* bsNormalError: Compares model->normals with exactly recomputed
+ * normals.
+ *
+ * basis   - basis prepared with bsNormalBasis()
+ * model   - the model passed to bsNormalBasis()
+ * maxerr  - returns the largest error in degrees
+ * meanerr - returns the mean error in degrees
+ */
+GLvoid
+bsNormalError(BSbasis* basis, GLMmodel* model, GLfloat* maxerr,
+              GLfloat* meanerr)
+{
+    GLfloat* exact;
+    GLfloat* n;
+    GLfloat dot, angle, sum;
+    GLuint i;
+
+    assert(basis);
+    assert(model);
+    assert(model->numnormals == basis->numvertices);
+
+    exact = (GLfloat*)malloc(sizeof(GLfloat) * 3 * model->numvertices);
+    bsAreaNormals(model, &model->vertices[3], exact);
+    bsNormalize(exact, model->numvertices);
+
+    *maxerr = 0.0;
+    sum = 0.0;
+    for (i = 0; i < model->numvertices; i++) {
+        n = &model->normals[3 * (i + 1)];
+        dot = n[0] * exact[3 * i + 0] + n[1] * exact[3 * i + 1] + n[2] * exact[3 * i + 2];
+        if (dot > 1.0f) dot = 1.0f;
+        if (dot < -1.0f) dot = -1.0f;
+        angle = (GLfloat)(acos(dot) * 180.0 / M_PI);
+        if (angle > *maxerr)
+            *maxerr = angle;
+        sum += angle;
+    }
+    *meanerr = model->numvertices ? sum / model->numvertices : 0.0f;
+
+    free(exact);
+}
+
+/* bsDelete: Deletes a BSbasis structure.
+ *
+ * basis - basis created with bsCreate()
+ */
+GLvoid
+bsDelete(BSbasis* basis)
+{
+    GLuint k;
+
+    assert(basis);
+
+    for (k = 0; k < BS_MAX_COMPONENTS; k++)
+        if (basis->normaldeltas[k])
+            free(basis->normaldeltas[k]);
+    if (basis->normals)
+        free(basis->normals);
+    free(basis);
+}
@@ -0,0 +1,143 @@
+/*
+      blend.h
+
+      Blendshape (PCA) evaluation for the animated head.
+
+      A shape is the mean shape plus a weighted sum of component
+      offsets, times a global scale, less a center:
+
+          p = scale * (mean + w[0] * c[0] + ... + w[k-1] * c[k-1]) - center
+
+      bsUnitize() sets the scale and center to the glmUnitize()
+      transform of the mean shape, so every blend comes out in one
+      fixed unitized frame instead of being unitized again per frame.
+
+      The same kernel also evaluates vertex normals.  bsNormalBasis()
+      linearizes the area-weighted vertex normals around the mean shape,
+      giving one normal derivative per component, so that the normals
+      of any blend cost one more blend plus a renormalize instead of a
+      full recomputation over the triangles.
+
+      Basis arrays are indexed from 0, model arrays from 1: basis vertex
+      i is model vertex i + 1.
+
+ */
+
+#ifndef BLEND_H
+#define BLEND_H
+
+#include "glm.h"
+
+
+#define BS_MAX_COMPONENTS 16    /* maximum number of components in a basis */
+
+
+/* BSbasis: Structure that defines a blendshape basis.
+ */
+typedef struct _BSbasis {
+  GLuint   numvertices;         /* number of vertices per shape */
+  GLuint   numcomponents;       /* number of components */
+  GLfloat  scale;               /* scale applied to every blended shape */
+  GLfloat  center[3];           /* subtracted from every scaled shape */
+  GLfloat* mean;                /* mean shape (3 GLfloats per vertex) */
+  GLfloat* components[BS_MAX_COMPONENTS]; /* component offsets */
+
+  GLfloat* normals;             /* normals of the mean shape, or NULL */
+  GLfloat* normaldeltas[BS_MAX_COMPONENTS]; /* normal derivatives per component */
+} BSbasis;
+
+
+/* bsCreate: Creates a basis around a mean shape.  The shape arrays are
+ * referenced, not copied, and must outlive the basis.  Returns a
+ * pointer to the created basis which should be free'd with
+ * bsDelete().
+ *
+ * numvertices - number of vertices per shape
+ * mean        - array of 3 * numvertices GLfloats
+ * scale       - scale applied to every blended shape
+ */
+BSbasis*
+bsCreate(GLuint numvertices, GLfloat* mean, GLfloat scale);
+
+/* bsUnitize: Folds the glmUnitize() transform of the mean shape into
+ * the scale and center of a basis, so that the mean shape blends to
+ * the unitized model and every other blend to the same frame.  Returns
+ * the unitizing scale factor.
+ *
+ * basis - basis created with bsCreate()
+ */
+GLfloat
+bsUnitize(BSbasis* basis);
+
+/* bsAddComponent: Appends a component to a basis.  Returns the index
+ * of the component.
+ *
+ * basis     - basis created with bsCreate()
+ * component - array of 3 * numvertices GLfloats
+ */
+GLuint
+bsAddComponent(BSbasis* basis, GLfloat* component);
+
+/* bsBlend: Evaluates the shape for a set of weights.
+ *
+ * basis    - basis created with bsCreate()
+ * weights  - array of numcomponents GLfloats
+ * vertices - array of 3 * numvertices GLfloats to write the shape to
+ *            (model->vertices + 3 for a GLMmodel)
+ */
+GLvoid
+bsBlend(BSbasis* basis, GLfloat* weights, GLfloat* vertices);
+
+/* bsNormalBasis: Precomputes the normal derivatives of every
+ * component around the mean shape, and switches the model to one
+ * normal per vertex (nindices == vindices) so that bsBlendNormals()
+ * can write them directly.  The model vertices must match the basis.
+ *
+ * basis - basis created with bsCreate()
+ * model - the model the basis animates
+ */
+GLvoid
+bsNormalBasis(BSbasis* basis, GLMmodel* model);
+
+/* bsBlendNormals: Evaluates approximate unit normals for a set of
+ * weights into model->normals.
+ *
+ * basis   - basis prepared with bsNormalBasis()
+ * weights - array of numcomponents GLfloats
+ * model   - the model passed to bsNormalBasis()
+ */
+GLvoid
+bsBlendNormals(BSbasis* basis, GLfloat* weights, GLMmodel* model);
+
+/* bsBlendNormalArray: Evaluates the normals of bsBlendNormals() into
+ * an array rather than a model.
+ *
+ * basis   - basis prepared with bsNormalBasis()
+ * weights - array of numcomponents GLfloats
+ * normals - array of 3 * numvertices GLfloats to write the normals to
+ */
+GLvoid
+bsBlendNormalArray(BSbasis* basis, GLfloat* weights, GLfloat* normals);
+
+/* bsNormalError: Compares model->normals with normals recomputed
+ * exactly from model->vertices, and reports the angular error in
+ * degrees.
+ *
+ * basis   - basis prepared with bsNormalBasis()
+ * model   - the model passed to bsNormalBasis()
+ * maxerr  - returns the largest error
+ * meanerr - returns the mean error
+ */
+GLvoid
+bsNormalError(BSbasis* basis, GLMmodel* model, GLfloat* maxerr,
+              GLfloat* meanerr);
+
+/* bsDelete: Deletes a BSbasis structure (the shape arrays passed to
+ * bsCreate() and bsAddComponent() are not free'd).
+ *
+ * basis - basis created with bsCreate()
+ */
+GLvoid
+bsDelete(BSbasis* basis);
+
+#endif
@@ -0,0 +1,499 @@
+/*
+      bvh.cpp
+
+      Bounding volume hierarchy over the triangles of a GLMmodel.
+
+      The tree is split at the middle of the centroid bounds along the
+      longest axis (falling back to an even split when all centroids
+      coincide), with at most BVH_LEAF_SIZE triangles per leaf.
+*/
+
+#include <math.h>
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "bvh.h"
+
+
+#define BVH_LEAF_SIZE  4        /* maximum triangles in a leaf */
+#define BVH_STACK_SIZE 64       /* traversal stack kept on the C stack */
+
+#define T(x) (model->triangles[(x)])
+#define V(x) (&model->vertices[3 * (x)])
+
+
+/* bvhBoxTriangles: compute the bounding box of a range of triangles
+ *
+ * tree  - the tree whose triangle list is used
+ * model - the model holding the vertices
+ * first - first entry in tree->triangles
+ * count - number of entries
+ * node  - node whose box is set
+ */
+static GLvoid
+bvhBoxTriangles(BVHtree* tree, GLMmodel* model, GLuint first, GLuint count,
+                BVHnode* node)
+{
+    GLuint i, j, k;
+    GLfloat* v;
+
+    node->bmin[0] = node->bmin[1] = node->bmin[2] =  FLT_MAX;
+    node->bmax[0] = node->bmax[1] = node->bmax[2] = -FLT_MAX;
+    for (i = first; i < first + count; i++) {
+        for (j = 0; j < 3; j++) {
+            v = V(T(tree->triangles[i]).vindices[j]);
+            for (k = 0; k < 3; k++) {
+                if (v[k] < node->bmin[k])
+                    node->bmin[k] = v[k];
+                if (v[k] > node->bmax[k])
+                    node->bmax[k] = v[k];
+            }
+        }
+    }
+}
+
+/* bvhSplit: recursively split a node into two children
+ *
+ * tree      - the tree being built
+ * model     - the model holding the vertices
+ * centroids - array of 3 GLfloats per triangle
+ * index     - index of the node to split
+ * depth     - edges from the root to the node
+ */
+static GLvoid
+bvhSplit(BVHtree* tree, GLMmodel* model, GLfloat* centroids, GLuint index,
+         GLuint depth)
+{
+    BVHnode* node;
+    GLfloat cmin[3], cmax[3], mid;
+    GLuint first, count, axis, i, j, swap, left;
+    GLfloat* c;
+
+    node = &tree->nodes[index];
+    first = node->first;
+    count = node->count;
+    bvhBoxTriangles(tree, model, first, count, node);
+    if (depth > tree->depth)
+        tree->depth = depth;
+    if (count <= BVH_LEAF_SIZE)
+        return;
+
+    /* split along the longest axis of the centroid bounds */
+    cmin[0] = cmin[1] = cmin[2] =  FLT_MAX;
+    cmax[0] = cmax[1] = cmax[2] = -FLT_MAX;
+    for (i = first; i < first + count; i++) {
+        c = &centroids[3 * tree->triangles[i]];
+        for (j = 0; j < 3; j++) {
+            if (c[j] < cmin[j]) cmin[j] = c[j];
+            if (c[j] > cmax[j]) cmax[j] = c[j];
+        }
+    }
+    axis = 0;
+    if (cmax[1] - cmin[1] > cmax[axis] - cmin[axis]) axis = 1;
+    if (cmax[2] - cmin[2] > cmax[axis] - cmin[axis]) axis = 2;
+    mid = (cmin[axis] + cmax[axis]) * 0.5f;
+
+    /* partition the triangles around the middle */
+    i = first;
+    j = first + count;
+    while (i < j) {
+        if (centroids[3 * tree->triangles[i] + axis] < mid) {
+            i++;
+        } else {
+            j--;
+            swap = tree->triangles[i];
+            tree->triangles[i] = tree->triangles[j];
+            tree->triangles[j] = swap;
+        }
+    }
+
+    /* all centroids on one side -- just halve the range */
+    if (i == first || i == first + count)
+        i = first + count / 2;
+
+    left = tree->numnodes;
+    tree->numnodes += 2;
+    node = &tree->nodes[index];
+    node->first = left;
+    node->count = 0;
+
+    tree->nodes[left].first = first;
+    tree->nodes[left].count = i - first;
+    tree->nodes[left + 1].first = i;
+    tree->nodes[left + 1].count = first + count - i;
+
+    bvhSplit(tree, model, centroids, left, depth + 1);
+    bvhSplit(tree, model, centroids, left + 1, depth + 1);
+}
+
+/* bvhStack: a traversal stack for the tree, the caller's local array if
+ * the tree is shallow enough (free with bvhStackFree()).  A traversal
+ * pushes at most one more entry per level than it pops, so depth + 2
+ * entries always suffice.
+ */
+static GLuint*
+bvhStack(BVHtree* tree, GLuint* local, GLuint* size)
+{
+    *size = tree->depth + 2;
+    if (*size <= BVH_STACK_SIZE)
+        return local;
+    return (GLuint*)malloc(sizeof(GLuint) * *size);
+}
+
+/* bvhStackFree: release a stack from bvhStack() */
+static GLvoid
+bvhStackFree(GLuint* stack, GLuint* local)
+{
+    if (stack != local)
+        free(stack);
+}
+
+/* bvhRayBox: slab test of a ray against a node box.  Returns the entry
+ * distance, or FLT_MAX if the box is missed or lies beyond tmax.
+ */
+static GLfloat
+bvhRayBox(BVHnode* node, GLfloat* origin, GLfloat* inv, GLfloat tmax)
+{
+    GLfloat t0, t1, tnear, tfar, swap;
+    GLuint i;
+
+    tnear = 0.0;
+    tfar = tmax;
+    for (i = 0; i < 3; i++) {
+        t0 = (node->bmin[i] - origin[i]) * inv[i];
+        t1 = (node->bmax[i] - origin[i]) * inv[i];
+        if (t0 > t1) {
+            swap = t0; t0 = t1; t1 = swap;
+        }
+        if (t0 > tnear) tnear = t0;
+        if (t1 < tfar)  tfar = t1;
+        if (tnear > tfar)
+            return FLT_MAX;
+    }
+    return tnear;
+}
+
+/* bvhRayTriangle: Moller-Trumbore ray/triangle test.  Returns GL_TRUE
+ * and the ray parameter and barycentric (u, v) if the ray hits the
+ * triangle closer than *t.
+ */
+static GLboolean
+bvhRayTriangle(GLfloat* origin, GLfloat* dir, GLfloat* a, GLfloat* b,
+               GLfloat* c, GLfloat* t, GLfloat* u, GLfloat* v)
+{
+    GLfloat e1[3], e2[3], p[3], s[3], q[3];
+    GLfloat det, inv, hu, hv, ht;
+
+    e1[0] = b[0] - a[0]; e1[1] = b[1] - a[1]; e1[2] = b[2] - a[2];
+    e2[0] = c[0] - a[0]; e2[1] = c[1] - a[1]; e2[2] = c[2] - a[2];
+
+    p[0] = dir[1] * e2[2] - dir[2] * e2[1];
+    p[1] = dir[2] * e2[0] - dir[0] * e2[2];
+    p[2] = dir[0] * e2[1] - dir[1] * e2[0];
+    det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+    if (det > -1e-12f && det < 1e-12f)
+        return GL_FALSE;
+    inv = 1.0f / det;
+
+    s[0] = origin[0] - a[0]; s[1] = origin[1] - a[1]; s[2] = origin[2] - a[2];
+    hu = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv;
+    if (hu < 0.0f || hu > 1.0f)
+        return GL_FALSE;
+
+    q[0] = s[1] * e1[2] - s[2] * e1[1];
+    q[1] = s[2] * e1[0] - s[0] * e1[2];
+    q[2] = s[0] * e1[1] - s[1] * e1[0];
+    hv = (dir[0] * q[0] + dir[1] * q[1] + dir[2] * q[2]) * inv;
+    if (hv < 0.0f || hu + hv > 1.0f)
+        return GL_FALSE;
+
+    ht = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv;
+    if (ht < 0.0f || ht >= *t)
+        return GL_FALSE;
+
+    *t = ht;
+    *u = hu;
+    *v = hv;
+    return GL_TRUE;
+}
+
+/* bvhBoxDistance: squared distance from a point to a node box */
+static GLfloat
+bvhBoxDistance(BVHnode* node, GLfloat* point)
+{
+    GLfloat d, dist;
+    GLuint i;
+
+    dist = 0.0;
+    for (i = 0; i < 3; i++) {
+        if (point[i] < node->bmin[i])
+            d = node->bmin[i] - point[i];
+        else if (point[i] > node->bmax[i])
+            d = point[i] - node->bmax[i];
+        else
+            d = 0.0;
+        dist += d * d;
+    }
+    return dist;
+}
+
+
+/* public functions */
+
+
+/* bvhBuild: Builds a hierarchy over all the triangles of a model.
+ *
+ * model - initialized GLMmodel structure
+ */
+BVHtree*
+bvhBuild(GLMmodel* model)
+{
+    BVHtree* tree;
+    GLfloat* centroids;
+    GLfloat* a;
+    GLfloat* b;
+    GLfloat* c;
+    GLuint i, j;
+
+    assert(model);
+    assert(model->vertices);
+
+    tree = (BVHtree*)malloc(sizeof(BVHtree));
+    tree->numtriangles = model->numtriangles;
+    tree->triangles = (GLuint*)malloc(sizeof(GLuint) * (model->numtriangles + 1));
+    for (i = 0; i < model->numtriangles; i++)
+        tree->triangles[i] = i;
+
+    /* a binary tree with n leaves has 2n - 1 nodes, and there is at
+       least one triangle per leaf */
+    tree->nodes = (BVHnode*)malloc(sizeof(BVHnode) * (2 * model->numtriangles + 1));
+    tree->numnodes = 1;
+    tree->depth = 0;
+    tree->nodes[0].first = 0;
+    tree->nodes[0].count = model->numtriangles;
+
+    centroids = (GLfloat*)malloc(sizeof(GLfloat) * 3 * (model->numtriangles + 1));
+    for (i = 0; i < model->numtriangles; i++) {
+        a = V(T(i).vindices[0]);
+        b = V(T(i).vindices[1]);
+        c = V(T(i).vindices[2]);
+        for (j = 0; j < 3; j++)
+            centroids[3 * i + j] = (a[j] + b[j] + c[j]) / 3.0f;
+    }
+
+    bvhSplit(tree, model, centroids, 0, 0);
+    free(centroids);
+
+    return tree;
+}
+
+/* bvhRefit: Recomputes the node boxes after the model vertices have
+ * moved.
+ *
+ * tree  - hierarchy built with bvhBuild()
+ * model - the model the tree was built for
+ */
+GLvoid
+bvhRefit(BVHtree* tree, GLMmodel* model)
+{
+    BVHnode* node;
+    BVHnode* left;
+    BVHnode* right;
+    GLint i;
+    GLuint j;
+
+    assert(tree);
+    assert(model);
+
+    /* children always come after their parent */
+    for (i = tree->numnodes - 1; i >= 0; i--) {
+        node = &tree->nodes[i];
+        if (node->count) {
+            bvhBoxTriangles(tree, model, node->first, node->count, node);
+        } else {
+            left = &tree->nodes[node->first];
+            right = left + 1;
+            for (j = 0; j < 3; j++) {
+                node->bmin[j] = left->bmin[j] < right->bmin[j] ? left->bmin[j] : right->bmin[j];
+                node->bmax[j] = left->bmax[j] > right->bmax[j] ? left->bmax[j] : right->bmax[j];
+            }
+        }
+    }
+}
+
+/* bvhIntersect: Finds the closest triangle hit by a ray.
+ *
+ * tree   - hierarchy built with bvhBuild()
+ * model  - the model the tree was built for
+ * origin - array of 3 GLfloats, the origin of the ray
+ * dir    - array of 3 GLfloats, the direction of the ray
+ * hit    - returns the hit information
+ */
+GLboolean
+bvhIntersect(BVHtree* tree, GLMmodel* model, GLfloat* origin, GLfloat* dir,
+             BVHhit* hit)
+{
+    GLuint local[BVH_STACK_SIZE];
+    GLuint* stack;
+    GLuint sp, size, i, j, index;
+    GLfloat inv[3], t, u, v, hu, hv, dl, dr;
+    GLboolean found;
+    BVHnode* node;
+    GLfloat* p[3];
+
+    assert(tree);
+    assert(model);
+    assert(hit);
+
+    if (!tree->numtriangles)
+        return GL_FALSE;
+
+    for (i = 0; i < 3; i++)
+        inv[i] = dir[i] != 0.0f ? 1.0f / dir[i] : FLT_MAX;
+
+    found = GL_FALSE;
+    t = FLT_MAX;
+    u = v = 0.0;
+    stack = bvhStack(tree, local, &size);
+    sp = 0;
+    stack[sp++] = 0;
+    while (sp) {
+        node = &tree->nodes[stack[--sp]];
+        if (bvhRayBox(node, origin, inv, t) == FLT_MAX)
+            continue;
+
+        if (node->count) {
+            for (i = node->first; i < node->first + node->count; i++) {
+                index = tree->triangles[i];
+                if (bvhRayTriangle(origin, dir,
+                                   V(T(index).vindices[0]),
+                                   V(T(index).vindices[1]),
+                                   V(T(index).vindices[2]),
+                                   &t, &hu, &hv)) {
+                    found = GL_TRUE;
+                    hit->triangle = index;
+                    u = hu;
+                    v = hv;
+                }
+            }
+        } else {
+            /* visit the nearer child first */
+            assert(sp + 2 <= size);
+            dl = bvhRayBox(&tree->nodes[node->first], origin, inv, t);
+            dr = bvhRayBox(&tree->nodes[node->first + 1], origin, inv, t);
+            if (dl < dr) {
+                if (dr != FLT_MAX) stack[sp++] = node->first + 1;
+                stack[sp++] = node->first;
+            } else {
+                if (dl != FLT_MAX) stack[sp++] = node->first;
+                if (dr != FLT_MAX) stack[sp++] = node->first + 1;
+            }
+        }
+    }
+    bvhStackFree(stack, local);
+
+    if (!found)
+        return GL_FALSE;
+
+    hit->t = t;
+    hit->bary[0] = 1.0f - u - v;
+    hit->bary[1] = u;
+    hit->bary[2] = v;
+    for (j = 0; j < 3; j++)
+        p[j] = V(T(hit->triangle).vindices[j]);
+    for (i = 0; i < 3; i++)
+        hit->position[i] = hit->bary[0] * p[0][i] + hit->bary[1] * p[1][i] +
+                           hit->bary[2] * p[2][i];
+
+    j = 0;
+    if (hit->bary[1] > hit->bary[j]) j = 1;
+    if (hit->bary[2] > hit->bary[j]) j = 2;
+    hit->vertex = T(hit->triangle).vindices[j];
+
+    return GL_TRUE;
+}
+
+/* bvhClosestVertex: Finds the model vertex closest to a point.
+ *
+ * tree     - hierarchy built with bvhBuild()
+ * model    - the model the tree was built for
+ * point    - array of 3 GLfloats, the query point
+ * distance - if not NULL, returns the distance to the vertex
+ */
+GLuint
+bvhClosestVertex(BVHtree* tree, GLMmodel* model, GLfloat* point,
+                 GLfloat* distance)
+{
+    GLuint local[BVH_STACK_SIZE];
+    GLuint* stack;
+    GLuint sp, size, i, j, vertex, closest;
+    GLfloat best, d, dl, dr, dx, dy, dz;
+    BVHnode* node;
+    GLfloat* v;
+
+    assert(tree);
+    assert(model);
+
+    closest = 0;
+    best = FLT_MAX;
+    if (!tree->numtriangles)
+        return closest;
+
+    stack = bvhStack(tree, local, &size);
+    sp = 0;
+    stack[sp++] = 0;
+    while (sp) {
+        node = &tree->nodes[stack[--sp]];
+        if (bvhBoxDistance(node, point) >= best)
+            continue;
+
+        if (node->count) {
+            for (i = node->first; i < node->first + node->count; i++) {
+                for (j = 0; j < 3; j++) {
+                    vertex = T(tree->triangles[i]).vindices[j];
+                    v = V(vertex);
+                    dx = v[0] - point[0];
+                    dy = v[1] - point[1];
+                    dz = v[2] - point[2];
+                    d = dx * dx + dy * dy + dz * dz;
+                    if (d < best) {
+                        best = d;
+                        closest = vertex;
+                    }
+                }
+            }
+        } else {
+            /* visit the nearer child first */
+            assert(sp + 2 <= size);
+            dl = bvhBoxDistance(&tree->nodes[node->first], point);
+            dr = bvhBoxDistance(&tree->nodes[node->first + 1], point);
+            if (dl < dr) {
+                stack[sp++] = node->first + 1;
+                stack[sp++] = node->first;
+            } else {
+                stack[sp++] = node->first;
+                stack[sp++] = node->first + 1;
+            }
+        }
+    }
+    bvhStackFree(stack, local);
+
+    if (distance)
+        *distance = (GLfloat)sqrt(best);
+    return closest;
+}
+
+/* bvhDelete: Deletes a BVHtree structure.
+ *
+ * tree - hierarchy built with bvhBuild()
+ */
+GLvoid
+bvhDelete(BVHtree* tree)
+{
+    assert(tree);
+
+    free(tree->nodes);
+    free(tree->triangles);
+    free(tree);
+}
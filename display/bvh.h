@@ -0,0 +1,106 @@
+/*
+      bvh.h
+
+      Bounding volume hierarchy over the triangles of a GLMmodel, used
+      for picking without reading back the depth buffer.
+
+      The hierarchy is built once from the model topology.  After the
+      vertices move (e.g. after every blendshape evaluation) only the
+      node boxes have to be recomputed with bvhRefit(), which is a single
+      linear pass over the nodes.
+
+ */
+
+#ifndef BVH_H
+#define BVH_H
+
+#include "glm.h"
+
+
+/* BVHnode: Structure that defines a node of the hierarchy.  Children
+ * of an inner node are stored next to each other (left, left + 1) and
+ * always after their parent, so the nodes can be refitted back to
+ * front.
+ */
+typedef struct _BVHnode {
+  GLfloat bmin[3];              /* minimum corner of the bounding box */
+  GLfloat bmax[3];              /* maximum corner of the bounding box */
+  GLuint  first;                /* leaf: first entry in triangles, inner: left child */
+  GLuint  count;                /* number of triangles in a leaf (0 for inner nodes) */
+} BVHnode;
+
+/* BVHtree: Structure that defines a hierarchy over a model.
+ */
+typedef struct _BVHtree {
+  GLuint   numnodes;            /* number of nodes in the tree */
+  BVHnode* nodes;               /* array of nodes, nodes[0] is the root */
+  GLuint   depth;               /* edges from the root to the deepest leaf */
+
+  GLuint   numtriangles;        /* number of triangles referenced by the leaves */
+  GLuint*  triangles;           /* array of triangle indices, grouped per leaf */
+} BVHtree;
+
+/* BVHhit: Structure that describes the result of a pick.
+ */
+typedef struct _BVHhit {
+  GLuint  triangle;             /* index of the triangle that was hit */
+  GLuint  vertex;               /* index of the triangle vertex closest to the hit */
+  GLfloat t;                    /* ray parameter of the hit */
+  GLfloat bary[3];              /* barycentric coordinates of the hit */
+  GLfloat position[3];          /* position of the hit */
+} BVHhit;
+
+
+/* bvhBuild: Builds a hierarchy over all the triangles of a model.
+ * Returns a pointer to the created tree which should be free'd with
+ * bvhDelete().
+ *
+ * model - initialized GLMmodel structure
+ */
+BVHtree*
+bvhBuild(GLMmodel* model);
+
+/* bvhRefit: Recomputes the node boxes after the model vertices have
+ * moved.  The topology of the model must not have changed.
+ *
+ * tree  - hierarchy built with bvhBuild()
+ * model - the model the tree was built for
+ */
+GLvoid
+bvhRefit(BVHtree* tree, GLMmodel* model);
+
+/* bvhIntersect: Finds the closest triangle hit by a ray (both faces
+ * are considered).  Returns GL_TRUE and fills in hit if a triangle was
+ * hit, GL_FALSE otherwise.
+ *
+ * tree   - hierarchy built with bvhBuild()
+ * model  - the model the tree was built for
+ * origin - array of 3 GLfloats, the origin of the ray
+ * dir    - array of 3 GLfloats, the direction of the ray (need not be
+ *          normalized, hit->t is expressed in multiples of it)
+ * hit    - returns the hit information
+ */
+GLboolean
+bvhIntersect(BVHtree* tree, GLMmodel* model, GLfloat* origin, GLfloat* dir,
+             BVHhit* hit);
+
+/* bvhClosestVertex: Finds the model vertex closest to a point.
+ * Returns the index of the vertex (0 if the model has no triangles).
+ *
+ * tree     - hierarchy built with bvhBuild()
+ * model    - the model the tree was built for
+ * point    - array of 3 GLfloats, the query point
+ * distance - if not NULL, returns the distance to the vertex
+ */
+GLuint
+bvhClosestVertex(BVHtree* tree, GLMmodel* model, GLfloat* point,
+                 GLfloat* distance);
+
+/* bvhDelete: Deletes a BVHtree structure.
+ *
+ * tree - hierarchy built with bvhBuild()
+ */
+GLvoid
+bvhDelete(BVHtree* tree);
+
+#endif
@@ -0,0 +1,154 @@
+/*
+      cache.cpp
+
+      Least recently used cache of deformed frames.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "cache.h"
+
+
+/* fcFind: the entry holding a key, or NULL */
+static FCentry*
+fcFind(FCcache* cache, GLint key)
+{
+    GLuint i;
+
+    for (i = 0; i < cache->numentries; i++)
+        if (cache->entries[i].key == key)
+            return &cache->entries[i];
+    return NULL;
+}
+
+
+/* public functions */
+
+
+/* fcCreate: Creates an empty cache.
+ *
+ * numentries - frames held
+ * size       - floats per frame
+ * numweights - weights per frame
+ */
+FCcache*
+fcCreate(GLuint numentries, GLuint size, GLuint numweights)
+{
+    FCcache* cache;
+    GLuint i;
+
+    assert(numentries > 0);
+    assert(size > 0);
+
+    cache = (FCcache*)malloc(sizeof(FCcache));
+    cache->numentries = numentries;
+    cache->size = size;
+    cache->numweights = numweights;
+    cache->clock = 0;
+    cache->hits = cache->misses = 0;
+    cache->entries = (FCentry*)malloc(sizeof(FCentry) * numentries);
+    for (i = 0; i < numentries; i++) {
+        cache->entries[i].key = -1;
+        cache->entries[i].lastuse = 0;
+        cache->entries[i].weights = (GLfloat*)malloc(sizeof(GLfloat) * numweights);
+        cache->entries[i].data = NULL;
+    }
+
+    return cache;
+}
+
+/* fcLookup: Returns the data of a frame, or NULL if it is not cached
+ * with these weights.
+ *
+ * cache   - structure created with fcCreate()
+ * key     - key of the frame, not negative
+ * weights - array of numweights GLfloats
+ */
+GLfloat*
+fcLookup(FCcache* cache, GLint key, GLfloat* weights)
+{
+    FCentry* entry;
+
+    assert(cache);
+    assert(key >= 0);
+
+    entry = fcFind(cache, key);
+    if (!entry || memcmp(entry->weights, weights, sizeof(GLfloat) * cache->numweights)) {
+        cache->misses++;
+        return NULL;
+    }
+
+    cache->hits++;
+    entry->lastuse = ++cache->clock;
+    return entry->data;
+}
+
+/* fcInsert: Makes room for a frame and returns the floats to fill.
+ *
+ * cache   - structure created with fcCreate()
+ * key     - key of the frame, not negative
+ * weights - array of numweights GLfloats
+ */
+GLfloat*
+fcInsert(FCcache* cache, GLint key, GLfloat* weights)
+{
+    FCentry* entry;
+    GLuint i;
+
+    assert(cache);
+    assert(key >= 0);
+
+    /* the same key with other weights, or the least recently used
+       entry (unused entries have never been used) */
+    entry = fcFind(cache, key);
+    if (!entry) {
+        entry = &cache->entries[0];
+        for (i = 1; i < cache->numentries; i++)
+            if (cache->entries[i].lastuse < entry->lastuse)
+                entry = &cache->entries[i];
+    }
+
+    if (!entry->data)
+        entry->data = (GLfloat*)malloc(sizeof(GLfloat) * cache->size);
+    entry->key = key;
+    entry->lastuse = ++cache->clock;
+    memcpy(entry->weights, weights, sizeof(GLfloat) * cache->numweights);
+    return entry->data;
+}
+
+/* fcClear: Drops every frame, keeping the memory.
+ *
+ * cache - structure created with fcCreate()
+ */
+GLvoid
+fcClear(FCcache* cache)
+{
+    GLuint i;
+
+    assert(cache);
+
+    for (i = 0; i < cache->numentries; i++) {
+        cache->entries[i].key = -1;
+        cache->entries[i].lastuse = 0;
+    }
+}
+
+/* fcDelete: Deletes a FCcache structure.
+ *
+ * cache - structure created with fcCreate()
+ */
+GLvoid
+fcDelete(FCcache* cache)
+{
+    GLuint i;
+
+    assert(cache);
+
+    for (i = 0; i < cache->numentries; i++) {
+        free(cache->entries[i].weights);
+        free(cache->entries[i].data);
+    }
+    free(cache->entries);
+    free(cache);
+}
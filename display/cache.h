@@ -0,0 +1,94 @@
+/*
+      cache.h
+
+      Least recently used cache of deformed frames.
+
+      An entry holds a fixed number of floats (the deformed vertices
+      and normals of one frame, in whatever layout the caller uses)
+      under an integer key, such as the frame index of a quantized
+      time.  The weights the frame was deformed with are stored along
+      with it and compared on lookup, so an entry is never returned
+      for a key whose weights have changed (other layers mixed in,
+      different gains).
+
+      The caches are small (tens of frames), so lookup is a linear
+      scan of the keys, far cheaper than the deformation it saves.
+
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "glm.h"
+
+
+/* FCentry: Structure that defines a cached frame.
+ */
+typedef struct _FCentry {
+  GLint    key;                 /* key of the frame, -1 if unused */
+  GLuint   lastuse;             /* cache clock at the last lookup or insert */
+  GLfloat* weights;             /* weights the frame was deformed with */
+  GLfloat* data;                /* size floats, allocated on first use */
+} FCentry;
+
+/* FCcache: Structure that defines a cache.
+ */
+typedef struct _FCcache {
+  GLuint   numentries;          /* number of entries */
+  GLuint   size;                /* floats per entry */
+  GLuint   numweights;          /* weights per entry */
+  GLuint   clock;               /* incremented on every lookup and insert */
+  FCentry* entries;             /* the entries */
+
+  GLuint   hits;                /* lookups that found their frame */
+  GLuint   misses;              /* lookups that did not */
+} FCcache;
+
+
+/* fcCreate: Creates an empty cache.  Entries are allocated as they
+ * are first filled.  Returns a pointer to the created structure which
+ * should be free'd with fcDelete().
+ *
+ * numentries - frames held
+ * size       - floats per frame
+ * numweights - weights per frame
+ */
+FCcache*
+fcCreate(GLuint numentries, GLuint size, GLuint numweights);
+
+/* fcLookup: Returns the data of a frame, or NULL if it is not cached
+ * with these weights.
+ *
+ * cache   - structure created with fcCreate()
+ * key     - key of the frame, not negative
+ * weights - array of numweights GLfloats
+ */
+GLfloat*
+fcLookup(FCcache* cache, GLint key, GLfloat* weights);
+
+/* fcInsert: Makes room for a frame, replacing the frame with the same
+ * key or else the least recently used one, and returns the size floats
+ * for the caller to fill.
+ *
+ * cache   - structure created with fcCreate()
+ * key     - key of the frame, not negative
+ * weights - array of numweights GLfloats
+ */
+GLfloat*
+fcInsert(FCcache* cache, GLint key, GLfloat* weights);
+
+/* fcClear: Drops every frame, keeping the memory.
+ *
+ * cache - structure created with fcCreate()
+ */
+GLvoid
+fcClear(FCcache* cache);
+
+/* fcDelete: Deletes a FCcache structure.
+ *
+ * cache - structure created with fcCreate()
+ */
+GLvoid
+fcDelete(FCcache* cache);
+
+#endif
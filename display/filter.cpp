@@ -0,0 +1,491 @@
+/*
+      filter.cpp
+
+      Streaming smoothing and resampling of weight frames.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "filter.h"
+#include "sequence.h"
+
+
+/* flCreate: the fields shared by every type of filter */
+static FLfilter*
+flCreate(GLuint type, GLuint numchannels, GLuint factor)
+{
+    FLfilter* filter;
+
+    assert(numchannels > 0);
+    assert(factor > 0);
+
+    filter = (FLfilter*)malloc(sizeof(FLfilter));
+    memset(filter, 0, sizeof(FLfilter));
+    filter->type = type;
+    filter->numchannels = numchannels;
+    filter->stride = (numchannels + 3) & ~3;
+    filter->factor = factor;
+    filter->count = 0;
+
+    /* the padding channels stay zero */
+    filter->sample = (GLfloat*)calloc(filter->stride, sizeof(GLfloat));
+    filter->result = (GLfloat*)calloc(filter->stride, sizeof(GLfloat));
+    return filter;
+}
+
+/* flConvolve: the FIR filter over the window, newest sample last */
+static GLvoid
+flConvolve(FLfilter* filter)
+{
+    GLfloat* newest;
+    GLuint i, c, stride;
+
+    stride = filter->stride;
+    newest = &filter->window[stride * (filter->position + filter->numtaps - 1)];
+#ifdef __SSE2__
+    for (c = 0; c < stride; c += 4) {
+        __m128 sum = _mm_setzero_ps();
+        for (i = 0; i < filter->numtaps; i++)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(filter->taps[i]),
+                _mm_loadu_ps(newest - stride * i + c)));
+        _mm_storeu_ps(&filter->result[c], sum);
+    }
+#else
+    for (c = 0; c < stride; c++) {
+        filter->result[c] = 0.0f;
+        for (i = 0; i < filter->numtaps; i++)
+            filter->result[c] += filter->taps[i] * (newest - stride * i)[c];
+    }
+#endif
+}
+
+/* flWindow: shift a sample into the FIR window; returns the number of
+ * samples written to out (one once the window is full)
+ */
+static GLuint
+flWindow(FLfilter* filter, GLfloat* sample, GLfloat* out)
+{
+    GLuint stride = filter->stride;
+
+    /* every sample is stored twice, numtaps slots apart, so that the
+       window is always contiguous from slot position */
+    memcpy(&filter->window[stride * filter->position], sample, sizeof(GLfloat) * stride);
+    memcpy(&filter->window[stride * (filter->position + filter->numtaps)], sample,
+        sizeof(GLfloat) * stride);
+    filter->position = (filter->position + 1) % filter->numtaps;
+    if (filter->filled < filter->numtaps)
+        filter->filled++;
+    if (filter->filled < filter->numtaps)
+        return 0;
+
+    flConvolve(filter);
+    memcpy(out, filter->result, sizeof(GLfloat) * filter->numchannels);
+    return 1;
+}
+
+/* flFIR: filter a sample with a FIR filter; returns the number of
+ * samples written to out
+ */
+static GLuint
+flFIR(FLfilter* filter, GLfloat* out)
+{
+    GLuint stride, m, k, n;
+
+    stride = filter->stride;
+    m = filter->numtaps - 1;
+    n = 0;
+
+    /* the start is reflected about the first sample, so nothing comes
+       out until sample m is in */
+    if (filter->count <= m)
+        memcpy(&filter->first[stride * filter->count], filter->sample, sizeof(GLfloat) * stride);
+    if (filter->count == m) {
+        for (k = 0; k < m; k++)
+            n += flWindow(filter, &filter->first[stride * (m - k)], out + n * filter->numchannels);
+        for (k = 0; k <= m; k++)
+            n += flWindow(filter, &filter->first[stride * k], out + n * filter->numchannels);
+    } else if (filter->count > m)
+        n = flWindow(filter, filter->sample, out);
+
+    filter->count++;
+    return n;
+}
+
+/* flFIRFlush: the reflected end of a FIR filter */
+static GLuint
+flFIRFlush(FLfilter* filter, GLfloat* out)
+{
+    GLuint stride, m, num, k, n;
+    GLint index;
+
+    stride = filter->stride;
+    m = filter->numtaps - 1;
+    num = filter->count;
+    n = 0;
+
+    if (num > m) {
+        /* the window holds the last numtaps samples; reflect about the
+           newest */
+        for (k = 0; k < m; k++)
+            memcpy(&filter->first[stride * k],
+                &filter->window[stride * (filter->position + m - 1 - k)], sizeof(GLfloat) * stride);
+        for (k = 0; k < m; k++)
+            n += flWindow(filter, &filter->first[stride * k], out + n * filter->numchannels);
+    } else if (num > 0) {
+        /* too short to reflect: the samples reflected at both ends,
+           held where the reflection runs past the other end */
+        for (k = 0; k < num + 2 * m; k++) {
+            if (k < m)
+                index = m - k;
+            else if (k < num + m)
+                index = k - m;
+            else
+                index = (GLint)num - 2 - (GLint)(k - num - m);
+            if (index < 0)
+                index = 0;
+            if (index > (GLint)num - 1)
+                index = num - 1;
+            n += flWindow(filter, &filter->first[stride * index], out + n * filter->numchannels);
+        }
+    }
+
+    filter->count = 0;
+    filter->position = 0;
+    filter->filled = 0;
+    return n;
+}
+
+/* flOneEuro: filter a sample with a one-euro filter; returns the
+ * number of samples written to out
+ */
+static GLuint
+flOneEuro(FLfilter* filter, GLfloat* out)
+{
+    GLuint c;
+
+    if (filter->count++ == 0) {
+        memcpy(filter->value, filter->sample, sizeof(GLfloat) * filter->stride);
+        memset(filter->speed, 0, sizeof(GLfloat) * filter->stride);
+        memcpy(out, filter->sample, sizeof(GLfloat) * filter->numchannels);
+        return 1;
+    }
+
+    /* alpha = 1 / (1 + rate / (2 pi cutoff)) */
+#ifdef __SSE2__
+    {
+        __m128 rate, twopi, dalpha, beta, mincutoff, x, value, speed, cutoff, alpha;
+
+        rate = _mm_set1_ps(filter->rate);
+        twopi = _mm_set1_ps(2.0f * (GLfloat)M_PI);
+        beta = _mm_set1_ps(filter->beta);
+        mincutoff = _mm_set1_ps(filter->mincutoff);
+        cutoff = _mm_set1_ps(2.0f * (GLfloat)M_PI * filter->dcutoff);
+        dalpha = _mm_div_ps(cutoff, _mm_add_ps(cutoff, rate));
+        for (c = 0; c < filter->stride; c += 4) {
+            x = _mm_loadu_ps(&filter->sample[c]);
+            value = _mm_loadu_ps(&filter->value[c]);
+            speed = _mm_loadu_ps(&filter->speed[c]);
+            speed = _mm_add_ps(speed, _mm_mul_ps(dalpha,
+                _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(x, value), rate), speed)));
+            cutoff = _mm_mul_ps(twopi, _mm_add_ps(mincutoff, _mm_mul_ps(beta,
+                _mm_max_ps(speed, _mm_sub_ps(_mm_setzero_ps(), speed)))));
+            alpha = _mm_div_ps(cutoff, _mm_add_ps(cutoff, rate));
+            value = _mm_add_ps(value, _mm_mul_ps(alpha, _mm_sub_ps(x, value)));
+            _mm_storeu_ps(&filter->speed[c], speed);
+            _mm_storeu_ps(&filter->value[c], value);
+        }
+    }
+#else
+    {
+        GLfloat dalpha, cutoff, alpha;
+
+        cutoff = 2.0f * (GLfloat)M_PI * filter->dcutoff;
+        dalpha = cutoff / (cutoff + filter->rate);
+        for (c = 0; c < filter->stride; c++) {
+            filter->speed[c] += dalpha *
+                ((filter->sample[c] - filter->value[c]) * filter->rate - filter->speed[c]);
+            cutoff = 2.0f * (GLfloat)M_PI *
+                (filter->mincutoff + filter->beta * fabs(filter->speed[c]));
+            alpha = cutoff / (cutoff + filter->rate);
+            filter->value[c] += alpha * (filter->sample[c] - filter->value[c]);
+        }
+    }
+#endif
+
+    memcpy(out, filter->value, sizeof(GLfloat) * filter->numchannels);
+    return 1;
+}
+
+/* flLength: a window length in SQ_FRAMETIME samples as a number of
+ * samples of sampletime ms, odd if it has to be */
+static GLuint
+flLength(GLuint length, GLfloat sampletime, GLboolean odd)
+{
+    if (sampletime > 0.0f)
+        length = (GLuint)(length * SQ_FRAMETIME / sampletime + 0.5f);
+    if (length < 1)
+        length = 1;
+    if (odd && length % 2 == 0)
+        length++;
+    return length;
+}
+
+
+/* public functions */
+
+
+/* flCreateFIR: Creates a FIR filter.
+ *
+ * numchannels - values per frame
+ * factor      - samples per input frame
+ * numtaps     - number of taps
+ * taps        - array of numtaps GLfloats, the first for the newest sample
+ */
+FLfilter*
+flCreateFIR(GLuint numchannels, GLuint factor, GLuint numtaps, GLfloat* taps)
+{
+    FLfilter* filter;
+
+    assert(numtaps > 0);
+    assert(taps);
+
+    filter = flCreate(FL_FIR, numchannels, factor);
+    filter->numtaps = numtaps;
+    filter->taps = (GLfloat*)malloc(sizeof(GLfloat) * numtaps);
+    memcpy(filter->taps, taps, sizeof(GLfloat) * numtaps);
+    filter->window = (GLfloat*)calloc(2 * numtaps * filter->stride, sizeof(GLfloat));
+    filter->first = (GLfloat*)calloc(numtaps * filter->stride, sizeof(GLfloat));
+    filter->position = 0;
+    filter->filled = 0;
+
+    return filter;
+}
+
+/* flCreateOneEuro: Creates a one-euro filter.
+ *
+ * numchannels - values per frame
+ * factor      - samples per input frame
+ * rate        - samples per second (after repeating)
+ * mincutoff   - cutoff at rest, Hz
+ * beta        - cutoff increase per unit per second of speed
+ * dcutoff     - cutoff of the speed estimate, Hz
+ */
+FLfilter*
+flCreateOneEuro(GLuint numchannels, GLuint factor, GLfloat rate,
+                GLfloat mincutoff, GLfloat beta, GLfloat dcutoff)
+{
+    FLfilter* filter;
+
+    assert(rate > 0.0f);
+    assert(mincutoff > 0.0f);
+    assert(dcutoff > 0.0f);
+
+    filter = flCreate(FL_ONEEURO, numchannels, factor);
+    filter->rate = rate;
+    filter->mincutoff = mincutoff;
+    filter->beta = beta;
+    filter->dcutoff = dcutoff;
+    filter->value = (GLfloat*)calloc(filter->stride, sizeof(GLfloat));
+    filter->speed = (GLfloat*)calloc(filter->stride, sizeof(GLfloat));
+
+    return filter;
+}
+
+/* flSavitzkyGolay: Computes the taps of a Savitzky-Golay smoother.
+ *
+ * numtaps - window length, odd and greater than order
+ * order   - degree of the polynomial
+ * taps    - array of numtaps GLfloats to write the taps to
+ */
+GLvoid
+flSavitzkyGolay(GLuint numtaps, GLuint order, GLfloat* taps)
+{
+    GLdouble normal[8][9], x, power, pivot;
+    GLint half, i;
+    GLuint j, k, l, n, best;
+
+    assert(numtaps % 2 == 1);
+    assert(order < numtaps);
+    assert(order < 8);
+
+    /* the normal equations of the fit, solved for the constant term:
+       normal * a = (1, 0, ...) */
+    n = order + 1;
+    half = numtaps / 2;
+    for (j = 0; j < n; j++) {
+        for (k = 0; k < n; k++) {
+            normal[j][k] = 0.0;
+            for (i = -half; i <= half; i++)
+                normal[j][k] += pow((GLdouble)i, (GLdouble)(j + k));
+        }
+        normal[j][n] = j == 0 ? 1.0 : 0.0;
+    }
+    for (j = 0; j < n; j++) {
+        best = j;
+        for (k = j + 1; k < n; k++)
+            if (fabs(normal[k][j]) > fabs(normal[best][j]))
+                best = k;
+        for (l = 0; l <= n; l++) {
+            x = normal[j][l];
+            normal[j][l] = normal[best][l];
+            normal[best][l] = x;
+        }
+        pivot = normal[j][j];
+        for (l = 0; l <= n; l++)
+            normal[j][l] /= pivot;
+        for (k = 0; k < n; k++) {
+            if (k == j)
+                continue;
+            x = normal[k][j];
+            for (l = 0; l <= n; l++)
+                normal[k][l] -= x * normal[j][l];
+        }
+    }
+
+    for (i = -half; i <= half; i++) {
+        x = 0.0;
+        power = 1.0;
+        for (j = 0; j < n; j++) {
+            x += normal[j][n] * power;
+            power *= i;
+        }
+        taps[i + half] = (GLfloat)x;
+    }
+}
+
+/* flParse: Creates a filter from a description.
+ *
+ * spec        - description of the filter
+ * numchannels - values per frame
+ * factor      - samples per input frame
+ * sampletime  - ms per sample (after repeating)
+ */
+FLfilter*
+flParse(const char* spec, GLuint numchannels, GLuint factor, GLfloat sampletime)
+{
+    FLfilter* filter;
+    GLfloat* taps;
+    GLdouble p[3];
+    char name[16];
+    GLuint length, i;
+    int n;
+
+    assert(spec);
+
+    n = sscanf(spec, "%15[a-z],%lf,%lf,%lf", name, &p[0], &p[1], &p[2]);
+    filter = NULL;
+    if (n >= 1 && !strcmp(name, "flat")) {
+        length = n > 1 ? (GLuint)p[0] : 11;
+        if (n <= 2 && length > 0 && length < 1000) {
+            length = flLength(length, sampletime, GL_FALSE);
+            taps = (GLfloat*)malloc(sizeof(GLfloat) * length);
+            for (i = 0; i < length; i++)
+                taps[i] = 1.0f / length;
+            filter = flCreateFIR(numchannels, factor, length, taps);
+            free(taps);
+        }
+    } else if (n >= 1 && !strcmp(name, "savgol")) {
+        length = n > 1 ? (GLuint)p[0] : 11;
+        i = n > 2 ? (GLuint)p[1] : 2;
+        if (n <= 3 && length % 2 == 1 && length < 1000 && i < length && i < 8) {
+            length = flLength(length, sampletime, GL_TRUE);
+            if (i >= length)
+                i = length - 1;
+            taps = (GLfloat*)malloc(sizeof(GLfloat) * length);
+            flSavitzkyGolay(length, i, taps);
+            filter = flCreateFIR(numchannels, factor, length, taps);
+            free(taps);
+        }
+    } else if (n >= 1 && !strcmp(name, "euro")) {
+        if ((n < 2 || p[0] > 0) && (n < 4 || p[2] > 0) && sampletime > 0)
+            filter = flCreateOneEuro(numchannels, factor, 1000.0f / sampletime,
+                n > 1 ? p[0] : 2.0, n > 2 ? p[1] : 0.5, n > 3 ? p[2] : 1.0);
+    }
+
+    if (!filter)
+        fprintf(stderr, "flParse() failed: \"%s\" is not a filter.\n", spec);
+    return filter;
+}
+
+/* flMaxSamples: Returns the most samples flPush() or flFlush() can
+ * write at once.
+ *
+ * filter - structure created with flCreateFIR() or flCreateOneEuro()
+ */
+GLuint
+flMaxSamples(FLfilter* filter)
+{
+    assert(filter);
+
+    return filter->factor + 2 * filter->numtaps;
+}
+
+/* flPush: Filters an input frame.
+ *
+ * filter - structure created with flCreateFIR() or flCreateOneEuro()
+ * frame  - array of numchannels GLfloats
+ * out    - array of flMaxSamples() * numchannels GLfloats to write the
+ *          samples to
+ */
+GLuint
+flPush(FLfilter* filter, GLfloat* frame, GLfloat* out)
+{
+    GLuint r, n;
+
+    assert(filter);
+    assert(frame);
+    assert(out);
+
+    memcpy(filter->sample, frame, sizeof(GLfloat) * filter->numchannels);
+    n = 0;
+    for (r = 0; r < filter->factor; r++) {
+        if (filter->type == FL_FIR)
+            n += flFIR(filter, out + n * filter->numchannels);
+        else
+            n += flOneEuro(filter, out + n * filter->numchannels);
+    }
+    return n;
+}
+
+/* flFlush: Ends the input, writing the samples still held back.
+ *
+ * filter - structure created with flCreateFIR() or flCreateOneEuro()
+ * out    - array of flMaxSamples() * numchannels GLfloats to write the
+ *          samples to
+ */
+GLuint
+flFlush(FLfilter* filter, GLfloat* out)
+{
+    assert(filter);
+    assert(out);
+
+    if (filter->type == FL_FIR)
+        return flFIRFlush(filter, out);
+    filter->count = 0;
+    return 0;
+}
+
+/* flDelete: Deletes a FLfilter structure.
+ *
+ * filter - structure created with flCreateFIR() or flCreateOneEuro()
+ */
+GLvoid
+flDelete(FLfilter* filter)
+{
+    assert(filter);
+
+    free(filter->taps);
+    free(filter->window);
+    free(filter->first);
+    free(filter->value);
+    free(filter->speed);
+    free(filter->sample);
+    free(filter->result);
+    free(filter);
+}
@@ -0,0 +1,158 @@
+/*
+      filter.h
+
+      Streaming smoothing and resampling of weight frames.
+
+      The model predicts one frame every SQ_MODELTIME ms.  A filter
+      takes those frames one at a time, repeats each factor times (the
+      np.repeat() of model/__init__.py) and smooths the repeated
+      samples with either
+
+        - a FIR filter, with the ends reflected like smooth() in
+          model/__init__.py, so that a flat window of 11 taps gives the
+          tracks the model writes to sequence0 to sequence15.  Output
+          sample j is written once input sample j has been pushed (once
+          sample numtaps - 1 has, at the start), and flFlush() writes
+          the numtaps - 1 samples of the reflected end.  Savitzky-Golay
+          smoothing is a FIR filter with the taps flSavitzkyGolay()
+          computes.
+        - a one-euro filter, a low-pass whose cutoff rises with the
+          speed of the signal.  It writes every sample as it is pushed
+          and flFlush() writes nothing.
+
+      Every channel of a frame goes through the same filter, four
+      channels at a time (SSE where available, one at a time otherwise).
+
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include "glm.h"
+
+
+#define FL_FIR 0                /* FIR filter with reflected ends */
+#define FL_ONEEURO 1            /* one-euro filter */
+
+
+/* FLfilter: Structure that defines a filter and its state.
+ */
+typedef struct _FLfilter {
+  GLuint   type;                /* FL_FIR or FL_ONEEURO */
+  GLuint   numchannels;         /* values per frame */
+  GLuint   stride;              /* numchannels rounded up to a multiple of 4 */
+  GLuint   factor;              /* samples per input frame */
+  GLuint   count;               /* samples pushed since the last flush */
+
+  GLuint   numtaps;             /* FIR: number of taps */
+  GLfloat* taps;                /* FIR: taps[0] weighs the newest sample */
+  GLfloat* window;              /* FIR: 2 * numtaps samples, each stored twice */
+  GLuint   position;            /* FIR: slot of the next sample in window */
+  GLuint   filled;              /* FIR: samples in window */
+  GLfloat* first;               /* FIR: the first numtaps samples */
+
+  GLfloat  rate;                /* one-euro: samples per second */
+  GLfloat  mincutoff;           /* one-euro: cutoff at rest, Hz */
+  GLfloat  beta;                /* one-euro: cutoff increase per unit/s */
+  GLfloat  dcutoff;             /* one-euro: cutoff of the speed, Hz */
+  GLfloat* value;               /* one-euro: filtered value */
+  GLfloat* speed;               /* one-euro: filtered speed */
+
+  GLfloat* sample;              /* the sample being filtered */
+  GLfloat* result;              /* the sample just filtered */
+} FLfilter;
+
+
+/* flCreateFIR: Creates a FIR filter.  Returns a pointer to the
+ * created structure which should be free'd with flDelete().
+ *
+ * numchannels - values per frame
+ * factor      - samples per input frame
+ * numtaps     - number of taps
+ * taps        - array of numtaps GLfloats, the first for the newest sample
+ */
+FLfilter*
+flCreateFIR(GLuint numchannels, GLuint factor, GLuint numtaps, GLfloat* taps);
+
+/* flCreateOneEuro: Creates a one-euro filter.  Returns a pointer to
+ * the created structure which should be free'd with flDelete().
+ *
+ * numchannels - values per frame
+ * factor      - samples per input frame
+ * rate        - samples per second (after repeating)
+ * mincutoff   - cutoff at rest, Hz
+ * beta        - cutoff increase per unit per second of speed
+ * dcutoff     - cutoff of the speed estimate, Hz
+ */
+FLfilter*
+flCreateOneEuro(GLuint numchannels, GLuint factor, GLfloat rate,
+                GLfloat mincutoff, GLfloat beta, GLfloat dcutoff);
+
+/* flSavitzkyGolay: Computes the taps of a Savitzky-Golay smoother,
+ * the value at the middle of a least squares polynomial fit.
+ *
+ * numtaps - window length, odd and greater than order
+ * order   - degree of the polynomial
+ * taps    - array of numtaps GLfloats to write the taps to
+ */
+GLvoid
+flSavitzkyGolay(GLuint numtaps, GLuint order, GLfloat* taps);
+
+/* flParse: Creates a filter from a description, one of
+ *
+ *     flat[,length]                     moving average (default 11,
+ *                                       the smoothing of the model)
+ *     savgol[,length[,order]]           Savitzky-Golay (default 11, 2)
+ *     euro[,mincutoff[,beta[,dcutoff]]] one-euro (default 2, 0.5, 1)
+ *
+ * Lengths count samples of SQ_FRAMETIME ms, as in the model, and are
+ * scaled to the sample time, so a window spans about the same time at
+ * any rate (flat,11 is 3 taps at SQ_MODELTIME).  Returns NULL (with a
+ * message) if the description is not valid.
+ *
+ * spec        - description of the filter
+ * numchannels - values per frame
+ * factor      - samples per input frame
+ * sampletime  - ms per sample (after repeating)
+ */
+FLfilter*
+flParse(const char* spec, GLuint numchannels, GLuint factor, GLfloat sampletime);
+
+/* flMaxSamples: Returns the most samples flPush() or flFlush() can
+ * write at once.
+ *
+ * filter - structure created with flCreateFIR() or flCreateOneEuro()
+ */
+GLuint
+flMaxSamples(FLfilter* filter);
+
+/* flPush: Filters an input frame.  Returns the number of samples
+ * written, the last of them the newest.
+ *
+ * filter - structure created with flCreateFIR() or flCreateOneEuro()
+ * frame  - array of numchannels GLfloats
+ * out    - array of flMaxSamples() * numchannels GLfloats to write the
+ *          samples to
+ */
+GLuint
+flPush(FLfilter* filter, GLfloat* frame, GLfloat* out);
+
+/* flFlush: Ends the input, writing the samples still held back, and
+ * resets the filter for the next input.  Returns the number of
+ * samples written.
+ *
+ * filter - structure created with flCreateFIR() or flCreateOneEuro()
+ * out    - array of flMaxSamples() * numchannels GLfloats to write the
+ *          samples to
+ */
+GLuint
+flFlush(FLfilter* filter, GLfloat* out);
+
+/* flDelete: Deletes a FLfilter structure.
+ *
+ * filter - structure created with flCreateFIR() or flCreateOneEuro()
+ */
+GLvoid
+flDelete(FLfilter* filter);
+
+#endif
@@ -35,6 +35,152 @@ typedef struct _GLMnode {
     struct _GLMnode* next;
 } GLMnode;
 
+/* _GLMblock: one block of an arena, the data follows the header */
+typedef struct _GLMblock {
+    size_t           size;          /* usable bytes in this block */
+    size_t           used;          /* bytes handed out so far */
+    struct _GLMblock* next;         /* previously filled block */
+} GLMblock;
+
+/* _GLMchunk: header of one allocation from an arena, the data follows
+   it; a released allocation links to the next one on the free list */
+typedef struct _GLMchunk {
+    size_t            size;         /* usable bytes of the allocation */
+    struct _GLMchunk* next;         /* next released allocation */
+} GLMchunk;
+
+/* _GLMarena: block allocator owning all the memory of a model */
+struct _GLMarena {
+    GLMblock* blocks;               /* current block, then older ones */
+    GLMchunk* released;             /* allocations given back by glmFree() */
+};
+
+#define GLM_ARENA_BLOCK (1 << 20)   /* default block size (1MB) */
+#define GLM_ARENA_ALIGN 16          /* alignment of every allocation */
+
+
+/* glmArenaCreate: create an empty arena */
+static GLMarena*
+glmArenaCreate(GLvoid)
+{
+    GLMarena* arena;
+    
+    arena = (GLMarena*)malloc(sizeof(GLMarena));
+    arena->blocks = NULL;
+    arena->released = NULL;
+    return arena;
+}
+
+/* glmArenaAlloc: hand out a released allocation that is large enough,
+ * or else carve size bytes (plus a chunk header) out of the current
+ * block, starting a new block (at least GLM_ARENA_BLOCK bytes) when it
+ * is full
+ */
+static GLvoid*
+glmArenaAlloc(GLMarena* arena, size_t size)
+{
+    GLMblock* block;
+    GLMchunk* chunk;
+    GLMchunk** link;
+    size_t    header, chunkheader, blocksize;
+    
+    header = (sizeof(GLMblock) + GLM_ARENA_ALIGN - 1) & ~(size_t)(GLM_ARENA_ALIGN - 1);
+    chunkheader = (sizeof(GLMchunk) + GLM_ARENA_ALIGN - 1) & ~(size_t)(GLM_ARENA_ALIGN - 1);
+    size = (size + GLM_ARENA_ALIGN - 1) & ~(size_t)(GLM_ARENA_ALIGN - 1);
+    
+    /* arrays regenerated at the same size (normals, facet normals)
+       take back the memory of the ones they replace */
+    for (link = &arena->released; *link; link = &(*link)->next) {
+        chunk = *link;
+        if (chunk->size >= size) {
+            *link = chunk->next;
+            return (char*)chunk + chunkheader;
+        }
+    }
+    
+    block = arena->blocks;
+    if (!block || block->used + chunkheader + size > block->size) {
+        blocksize = chunkheader + size > GLM_ARENA_BLOCK ? chunkheader + size : GLM_ARENA_BLOCK;
+        block = (GLMblock*)malloc(header + blocksize);
+        block->size = blocksize;
+        block->used = 0;
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+    
+    chunk = (GLMchunk*)((char*)block + header + block->used);
+    chunk->size = size;
+    block->used += chunkheader + size;
+    return (char*)chunk + chunkheader;
+}
+
+/* glmArenaRelease: put an allocation on the free list of its arena */
+static GLvoid
+glmArenaRelease(GLMarena* arena, GLvoid* ptr)
+{
+    GLMchunk* chunk;
+    size_t    chunkheader;
+    
+    chunkheader = (sizeof(GLMchunk) + GLM_ARENA_ALIGN - 1) & ~(size_t)(GLM_ARENA_ALIGN - 1);
+    chunk = (GLMchunk*)((char*)ptr - chunkheader);
+    chunk->next = arena->released;
+    arena->released = chunk;
+}
+
+/* glmArenaDelete: release every block of an arena at once */
+static GLvoid
+glmArenaDelete(GLMarena* arena)
+{
+    GLMblock* block;
+    
+    while (arena->blocks) {
+        block = arena->blocks;
+        arena->blocks = block->next;
+        free(block);
+    }
+    free(arena);
+}
+
+/* glmMalloc: Allocates memory owned by a model, from its arena if it
+ * has one.
+ *
+ * model - initialized GLMmodel structure
+ * size  - number of bytes
+ */
+GLvoid*
+glmMalloc(GLMmodel* model, size_t size)
+{
+    if (model->arena)
+        return glmArenaAlloc(model->arena, size);
+    return malloc(size);
+}
+
+/* glmFree: Releases memory allocated with glmMalloc().
+ *
+ * model - initialized GLMmodel structure
+ * ptr   - memory allocated with glmMalloc(), or NULL
+ */
+GLvoid
+glmFree(GLMmodel* model, GLvoid* ptr)
+{
+    if (!ptr)
+        return;
+    if (model->arena)
+        glmArenaRelease(model->arena, ptr);
+    else
+        free(ptr);
+}
+
+/* glmStrdup: strdup() into memory owned by a model */
+static char*
+glmStrdup(GLMmodel* model, const char* s)
+{
+    char* copy;
+    
+    copy = (char*)glmMalloc(model, strlen(s) + 1);
+    strcpy(copy, s);
+    return copy;
+}
 
 /* glmMax: returns the maximum of two floats */
 static GLfloat
@@ -163,7 +309,7 @@ duplicate:
 
 /* glmFindGroup: Find a group in the model */
 GLMgroup*
-glmFindGroup(GLMmodel* model, char* name)
+glmFindGroup(GLMmodel* model, const char* name)
 {
     GLMgroup* group;
     
@@ -181,14 +327,14 @@ glmFindGroup(GLMmodel* model, char* name)
 
 /* glmAddGroup: Add a group to the model */
 GLMgroup*
-glmAddGroup(GLMmodel* model, char* name)
+glmAddGroup(GLMmodel* model, const char* name)
 {
     GLMgroup* group;
     
     group = glmFindGroup(model, name);
     if (!group) {
-        group = (GLMgroup*)malloc(sizeof(GLMgroup));
-        group->name = strdup(name);
+        group = (GLMgroup*)glmMalloc(model, sizeof(GLMgroup));
+        group->name = glmStrdup(model, name);
         group->material = 0;
         group->numtriangles = 0;
         group->triangles = NULL;
@@ -281,8 +427,16 @@ int glmFindOrAddTexture(GLMmodel* model, char* name,mycallback *call)
 	if (filename[lung-2]<32) filename[lung-2]=0;    
 
     model->numtextures++;
-    model->textures = (GLMtexture*)realloc(model->textures, sizeof(GLMtexture)*model->numtextures);
-    model->textures[model->numtextures-1].name = strdup(numefis);
+    if (model->arena) {
+        /* no realloc in an arena -- copy into a larger array */
+        GLMtexture* textures = (GLMtexture*)glmMalloc(model, sizeof(GLMtexture)*model->numtextures);
+        if (model->textures)
+            memcpy(textures, model->textures, sizeof(GLMtexture)*(model->numtextures-1));
+        model->textures = textures;
+    } else {
+        model->textures = (GLMtexture*)realloc(model->textures, sizeof(GLMtexture)*model->numtextures);
+    }
+    model->textures[model->numtextures-1].name = glmStrdup(model, numefis);
     //model->textures[model->numtextures-1].id = glmLoadTexture(filename, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE, &width, &height);	
     model->textures[model->numtextures-1].width = width;
     model->textures[model->numtextures-1].height = height;
@@ -347,7 +501,7 @@ glmReadMTL(GLMmodel* model, char* name, mycallback *call)
     
     rewind(file);
     
-    model->materials = (GLMmaterial*)malloc(sizeof(GLMmaterial) * nummaterials);
+    model->materials = (GLMmaterial*)glmMalloc(model, sizeof(GLMmaterial) * nummaterials);
     model->nummaterials = nummaterials;
     
     /* set the default material */
@@ -368,7 +522,7 @@ glmReadMTL(GLMmodel* model, char* name, mycallback *call)
         model->materials[i].specular[3] = 1.0;
 		model->materials[i].IDTextura = -1;
     }
-    model->materials[0].name = strdup("default");
+    model->materials[0].name = glmStrdup(model, "default");
     
     /* now, read in the data */
     nummaterials = 0;
@@ -382,7 +536,7 @@ glmReadMTL(GLMmodel* model, char* name, mycallback *call)
             fgets(buf, sizeof(buf), file);
             sscanf(buf, "%s %s", buf, buf);
             nummaterials++;
-            model->materials[nummaterials].name = strdup(buf);
+            model->materials[nummaterials].name = glmStrdup(model, buf);
             break;
         case 'N':
             if (buf[1]!='s') break; // 3DS pune 'i' aici pentru indici de refractie si se incurca
@@ -550,7 +704,7 @@ static GLvoid glmFirstPass(GLMmodel* model, FILE* file, mycallback *call)
             case 'm': //mtllib
                 fgets(buf, sizeof(buf), file);
                 sscanf(buf, "%s %s", buf, buf);
-                model->mtllibname = strdup(buf);
+                model->mtllibname = glmStrdup(model, buf);
                 glmReadMTL(model, buf, call);
                 break;
             case 'u': //usemtl
@@ -631,7 +785,7 @@ static GLvoid glmFirstPass(GLMmodel* model, FILE* file, mycallback *call)
   /* allocate memory for the triangles in each group */
   group = model->groups;
   while(group) {
-      group->triangles = (GLuint*)malloc(sizeof(GLuint) * group->numtriangles);
+      group->triangles = (GLuint*)glmMalloc(model, sizeof(GLuint) * group->numtriangles);
       group->numtriangles = 0;
       group = group->next;
   }
@@ -1040,11 +1194,11 @@ glmFacetNormals(GLMmodel* model)
     
     /* clobber any old facetnormals */
     if (model->facetnorms)
-        free(model->facetnorms);
+        glmFree(model, model->facetnorms);
     
     /* allocate memory for the new facet normals */
     model->numfacetnorms = model->numtriangles;
-    model->facetnorms = (GLfloat*)malloc(sizeof(GLfloat) *
+    model->facetnorms = (GLfloat*)glmMalloc(model, sizeof(GLfloat) *
                        3 * (model->numfacetnorms + 1));
     
     for (i = 0; i < model->numtriangles; i++) 
@@ -1090,7 +1244,7 @@ GLvoid
 glmVertexNormals(GLMmodel* model, GLfloat angle)
 {
     GLMnode*    node;
-    GLMnode*    tail;
+    GLMnode*    nodes;
     GLMnode** members;
     GLfloat*    normals;
     GLuint  numnormals;
@@ -1106,11 +1260,11 @@ glmVertexNormals(GLMmodel* model, GLfloat angle)
     
     /* nuke any previous normals */
     if (model->normals)
-        free(model->normals);
+        glmFree(model, model->normals);
     
-    /* allocate space for new normals */
+    /* allocate scratch space for new normals */
     model->numnormals = model->numtriangles * 3; /* 3 normals per triangle */
-    model->normals = (GLfloat*)malloc(sizeof(GLfloat)* 3* (model->numnormals+1));
+    normals = (GLfloat*)malloc(sizeof(GLfloat)* 3* (model->numnormals+1));
     
     /* allocate a structure that will hold a linked list of triangle
     indices for each vertex */
@@ -1118,19 +1272,21 @@ glmVertexNormals(GLMmodel* model, GLfloat angle)
     for (i = 1; i <= model->numvertices; i++)
         members[i] = NULL;
     
-    /* for every triangle, create a node for each vertex in it */
+    /* for every triangle, create a node for each vertex in it (all the
+    nodes come from one block instead of a malloc per corner) */
+    nodes = (GLMnode*)malloc(sizeof(GLMnode) * 3 * (model->numtriangles + 1));
     for (i = 0; i < model->numtriangles; i++) {
-        node = (GLMnode*)malloc(sizeof(GLMnode));
+        node = &nodes[3 * i + 0];
         node->index = i;
         node->next  = members[T(i).vindices[0]];
         members[T(i).vindices[0]] = node;
         
-        node = (GLMnode*)malloc(sizeof(GLMnode));
+        node = &nodes[3 * i + 1];
         node->index = i;
         node->next  = members[T(i).vindices[1]];
         members[T(i).vindices[1]] = node;
         
-        node = (GLMnode*)malloc(sizeof(GLMnode));
+        node = &nodes[3 * i + 2];
         node->index = i;
         node->next  = members[T(i).vindices[2]];
         members[T(i).vindices[2]] = node;
@@ -1170,9 +1326,9 @@ glmVertexNormals(GLMmodel* model, GLfloat angle)
             glmNormalize(average);
             
             /* add the normal to the vertex normals list */
-            model->normals[3 * numnormals + 0] = average[0];
-            model->normals[3 * numnormals + 1] = average[1];
-            model->normals[3 * numnormals + 2] = average[2];
+            normals[3 * numnormals + 0] = average[0];
+            normals[3 * numnormals + 1] = average[1];
+            normals[3 * numnormals + 2] = average[2];
             avg = numnormals;
             numnormals++;
         }
@@ -1197,11 +1353,11 @@ glmVertexNormals(GLMmodel* model, GLfloat angle)
             } else {
 				
                 /* if this node wasn't averaged, use the facet normal */
-                model->normals[3 * numnormals + 0] = 
+                normals[3 * numnormals + 0] = 
                     model->facetnorms[3 * T(node->index).findex + 0];
-                model->normals[3 * numnormals + 1] = 
+                normals[3 * numnormals + 1] = 
                     model->facetnorms[3 * T(node->index).findex + 1];
-                model->normals[3 * numnormals + 2] = 
+                normals[3 * numnormals + 2] = 
                     model->facetnorms[3 * T(node->index).findex + 2];
                 if (T(node->index).vindices[0] == i)
                     T(node->index).nindices[0] = numnormals;
@@ -1218,22 +1374,14 @@ glmVertexNormals(GLMmodel* model, GLfloat angle)
     model->numnormals = numnormals - 1;
     
     /* free the member information */
-    for (i = 1; i <= model->numvertices; i++) {
-        node = members[i];
-        while (node) {
-            tail = node;
-            node = node->next;
-            free(tail);
-        }
-    }
+    free(nodes);
     free(members);
     
     /* pack the normals array (we previously allocated the maximum
     number of normals that could possibly be created (numtriangles *
     3), so get rid of some of them (usually alot unless none of the
     facet normals were averaged)) */
-    normals = model->normals;
-    model->normals = (GLfloat*)malloc(sizeof(GLfloat)* 3* (model->numnormals+1));
+    model->normals = (GLfloat*)glmMalloc(model, sizeof(GLfloat)* 3* (model->numnormals+1));
     for (i = 1; i <= model->numnormals; i++) {
         model->normals[3 * i + 0] = normals[3 * i + 0];
         model->normals[3 * i + 1] = normals[3 * i + 1];
@@ -1253,9 +1401,9 @@ glmLinearTexture(GLMmodel* model)
     assert(model);
     
     if (model->texcoords)
-        free(model->texcoords);
+        glmFree(model, model->texcoords);
     model->numtexcoords = model->numvertices;
-    model->texcoords=(GLfloat*)malloc(sizeof(GLfloat)*2*(model->numtexcoords+1));
+    model->texcoords=(GLfloat*)glmMalloc(model, sizeof(GLfloat)*2*(model->numtexcoords+1));
     
     glmDimensions(model, dimensions);
     scalefactor = 2.0 / 
@@ -1308,9 +1456,9 @@ glmSpheremapTexture(GLMmodel* model)
     assert(model->normals);
     
     if (model->texcoords)
-        free(model->texcoords);
+        glmFree(model, model->texcoords);
     model->numtexcoords = model->numnormals;
-    model->texcoords=(GLfloat*)malloc(sizeof(GLfloat)*2*(model->numtexcoords+1));
+    model->texcoords=(GLfloat*)glmMalloc(model, sizeof(GLfloat)*2*(model->numtexcoords+1));
     
     for (i = 1; i <= model->numnormals; i++) {
         z = model->normals[3 * i + 0];  /* re-arrange for pole distortion */
@@ -1362,6 +1510,14 @@ glmDelete(GLMmodel* model)
     
     assert(model);
     
+    if (model->arena) {
+        /* everything but the texture objects lives in the arena */
+        for (i = 0; i < model->numtextures; i++)
+            glDeleteTextures(1,&model->textures[i].id);
+        glmArenaDelete(model->arena);
+        return;
+    }
+    
     if (model->pathname)     free(model->pathname);
     if (model->mtllibname) free(model->mtllibname);
     if (model->vertices)     free(model->vertices);
@@ -1400,13 +1556,18 @@ glmDelete(GLMmodel* model)
  * filename - name of the file containing the Wavefront .OBJ format data.  
  */
 
-GLMmodel* glmReadOBJ(char* filename)
+GLMmodel* glmReadOBJ(const char* filename)
 {
 	return glmReadOBJ(filename,0);
 }
-GLMmodel* glmReadOBJ(char* filename,mycallback *call)
+GLMmodel* glmReadOBJ(const char* filename,mycallback *call)
+{
+	return glmReadOBJ(filename,call,GL_FALSE);
+}
+GLMmodel* glmReadOBJ(const char* filename,mycallback *call,GLboolean arena)
 {
     GLMmodel* model;
+    GLMarena* modelarena;
     FILE*   file;
 	//if (call) call->loadcallback(0,"Loading Models...");
     /* open the file */
@@ -1417,9 +1578,16 @@ GLMmodel* glmReadOBJ(char* filename,mycallback *call)
         exit(1);
     }
     
-    /* allocate a new model */
-    model = (GLMmodel*)malloc(sizeof(GLMmodel));
-    model->pathname    = strdup(filename);
+    /* allocate a new model (inside its own arena if requested) */
+    if (arena) {
+        modelarena = glmArenaCreate();
+        model = (GLMmodel*)glmArenaAlloc(modelarena, sizeof(GLMmodel));
+        model->arena = modelarena;
+    } else {
+        model = (GLMmodel*)malloc(sizeof(GLMmodel));
+        model->arena = NULL;
+    }
+    model->pathname    = glmStrdup(model, filename);
     model->mtllibname    = NULL;
     model->numvertices   = 0;
     model->vertices    = NULL;
@@ -1446,16 +1614,16 @@ GLMmodel* glmReadOBJ(char* filename,mycallback *call)
     glmFirstPass(model, file, call);
     
     /* allocate memory */
-    model->vertices = (GLfloat*)malloc(sizeof(GLfloat) *
+    model->vertices = (GLfloat*)glmMalloc(model, sizeof(GLfloat) *
         3 * (model->numvertices + 1));
-    model->triangles = (GLMtriangle*)malloc(sizeof(GLMtriangle) *
+    model->triangles = (GLMtriangle*)glmMalloc(model, sizeof(GLMtriangle) *
         model->numtriangles);
     if (model->numnormals) {
-        model->normals = (GLfloat*)malloc(sizeof(GLfloat) *
+        model->normals = (GLfloat*)glmMalloc(model, sizeof(GLfloat) *
             3 * (model->numnormals + 1));
     }
     if (model->numtexcoords) {
-        model->texcoords = (GLfloat*)malloc(sizeof(GLfloat) *
+        model->texcoords = (GLfloat*)glmMalloc(model, sizeof(GLfloat) *
             2 * (model->numtexcoords + 1));
     }
     
@@ -1664,6 +1832,67 @@ glmWriteOBJ(GLMmodel* model, char* filename, GLuint mode)
     fclose(file);
 }
 
+/* glmDrawTriangles: the inner loop of glmDraw(), generated for each
+ * combination of the per-vertex mode bits so that none of them is
+ * tested per vertex.  Only GLM_FLAT, GLM_SMOOTH and GLM_TEXTURE matter
+ * here; glmDraw() has already dropped GLM_FLAT if GLM_SMOOTH is set.
+ */
+template <GLuint mode>
+static GLvoid
+glmDrawTriangles(GLMmodel* model, GLMgroup* group)
+{
+    GLMtriangle* triangle;
+    GLuint i, j;
+
+    glBegin(GL_TRIANGLES);
+    for (i = 0; i < group->numtriangles; i++) {
+        triangle = &T(group->triangles[i]);
+#ifdef DebugVisibleSurfaces
+        if (!triangle->visible) continue;
+#endif
+        if (mode & GLM_FLAT)
+            glNormal3fv(&model->facetnorms[3 * triangle->findex]);
+        for (j = 0; j < 3; j++) {
+            if (mode & GLM_SMOOTH)
+                glNormal3fv(&model->normals[3 * triangle->nindices[j]]);
+            if (mode & GLM_TEXTURE)
+                glTexCoord2fv(&model->texcoords[2 * triangle->tindices[j]]);
+            glVertex3fv(&model->vertices[3 * triangle->vindices[j]]);
+        }
+    }
+    glEnd();
+}
+
+/* glmDrawTriangles<GLM_SMOOTH>: the mode Display() and glmList() are
+ * used with, with the corners written out.
+ */
+template <>
+GLvoid
+glmDrawTriangles<GLM_SMOOTH>(GLMmodel* model, GLMgroup* group)
+{
+    GLMtriangle* triangle;
+    GLfloat* normals;
+    GLfloat* vertices;
+    GLuint i;
+
+    normals = model->normals;
+    vertices = model->vertices;
+    glBegin(GL_TRIANGLES);
+    for (i = 0; i < group->numtriangles; i++) {
+        triangle = &T(group->triangles[i]);
+#ifdef DebugVisibleSurfaces
+        if (!triangle->visible) continue;
+#endif
+        glNormal3fv(&normals[3 * triangle->nindices[0]]);
+        glVertex3fv(&vertices[3 * triangle->vindices[0]]);
+        glNormal3fv(&normals[3 * triangle->nindices[1]]);
+        glVertex3fv(&vertices[3 * triangle->vindices[1]]);
+        glNormal3fv(&normals[3 * triangle->nindices[2]]);
+        glVertex3fv(&vertices[3 * triangle->vindices[2]]);
+    }
+    glEnd();
+}
+
 /* glmDraw: Renders the model to the current OpenGL context using the
  * mode specified.
  *
@@ -1685,11 +1914,10 @@ GLvoid glmDraw(GLMmodel* model, GLuint mode)
 }
 GLvoid glmDraw(GLMmodel* model, GLuint mode,char *drawonly)
 {
-    static GLuint i;
-    static GLMgroup* group;
-    static GLMtriangle* triangle;
-    static GLMmaterial* material;
+    GLMgroup* group;
+    GLMmaterial* material;
     GLuint IDTextura;
+    GLvoid (*drawtriangles)(GLMmodel*, GLMgroup*);
     
     assert(model);
     assert(model->vertices);
@@ -1738,11 +1966,29 @@ GLvoid glmDraw(GLMmodel* model, GLuint mode,char *drawonly)
         glEnable(GL_TEXTURE_2D);
         glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
     }
-    /* perhaps this loop should be unrolled into material, color, flat,
-       smooth, etc. loops?  since most cpu's have good branch prediction
-       schemes (and these branches will always go one way), probably
-       wouldn't gain too much?  */
-    
+    /* pick the inner loop once, rather than testing the mode for
+       every vertex */
+    switch (mode & (GLM_FLAT | GLM_SMOOTH | GLM_TEXTURE)) {
+    case GLM_FLAT:
+        drawtriangles = glmDrawTriangles<GLM_FLAT>;
+        break;
+    case GLM_SMOOTH:
+        drawtriangles = glmDrawTriangles<GLM_SMOOTH>;
+        break;
+    case GLM_TEXTURE:
+        drawtriangles = glmDrawTriangles<GLM_TEXTURE>;
+        break;
+    case GLM_FLAT | GLM_TEXTURE:
+        drawtriangles = glmDrawTriangles<GLM_FLAT | GLM_TEXTURE>;
+        break;
+    case GLM_SMOOTH | GLM_TEXTURE:
+        drawtriangles = glmDrawTriangles<GLM_SMOOTH | GLM_TEXTURE>;
+        break;
+    default:
+        drawtriangles = glmDrawTriangles<GLM_NONE>;
+        break;
+    }
+
     IDTextura = -1;
     group = model->groups;
     while (group) 
@@ -1779,38 +2025,7 @@ GLvoid glmDraw(GLMmodel* model, GLuint mode,char *drawonly)
             glColor3fv(material->diffuse);
         }
         
-        glBegin(GL_TRIANGLES);
-        for (i = 0; i < group->numtriangles; i++) {
-            triangle = &T(group->triangles[i]);
-#ifdef DebugVisibleSurfaces
-			if (!triangle->visible) continue;
-#endif
-            if (mode & GLM_FLAT)
-                glNormal3fv(&model->facetnorms[3 * triangle->findex]);
-            
-            if (mode & GLM_SMOOTH)
-                glNormal3fv(&model->normals[3 * triangle->nindices[0]]);
-            if (mode & GLM_TEXTURE)
-                glTexCoord2fv(&model->texcoords[2 * triangle->tindices[0]]);
-            glVertex3fv(&model->vertices[3 * triangle->vindices[0]]);
-            
-            if (mode & GLM_SMOOTH)
-                glNormal3fv(&model->normals[3 * triangle->nindices[1]]);
-            if (mode & GLM_TEXTURE)
-	    {
-                //if (IDTextura==-1) printf("Warning: GLM_TEXTURE este on dar nu este setata nici o textura in material!");
-                glTexCoord2fv(&model->texcoords[2 * triangle->tindices[1]]);
-            }
-            glVertex3fv(&model->vertices[3 * triangle->vindices[1]]);
-            
-            if (mode & GLM_SMOOTH)
-                glNormal3fv(&model->normals[3 * triangle->nindices[2]]);
-            if (mode & GLM_TEXTURE)
-                glTexCoord2fv(&model->texcoords[2 * triangle->tindices[2]]);
-            glVertex3fv(&model->vertices[3 * triangle->vindices[2]]);
-            
-        }
-        glEnd();
+        drawtriangles(model, group);
         
         group = group->next;
     }
@@ -1876,11 +2091,11 @@ glmWeld(GLMmodel* model, GLfloat epsilon)
     }
     
     /* free space for old vertices */
-    free(vectors);
+    glmFree(model, vectors);
     
     /* allocate space for the new vertices */
     model->numvertices = numvectors;
-    model->vertices = (GLfloat*)malloc(sizeof(GLfloat) * 
+    model->vertices = (GLfloat*)glmMalloc(model, sizeof(GLfloat) * 
         3 * (model->numvertices + 1));
     
     /* copy the optimized vertices into the actual vertex list */
@@ -1893,6 +2108,305 @@ glmWeld(GLMmodel* model, GLfloat epsilon)
     free(copies);
 }
 
+/* glmIndexedHash: hash of a (vertex, normal, texcoord) index triple */
+static GLuint
+glmIndexedHash(GLuint v, GLuint n, GLuint t, GLuint mask)
+{
+    return ((v * 2654435761u) ^ (n * 2246822519u) ^ (t * 3266489917u)) & mask;
+}
+
+/* glmIndexed: Welds the triangle corners of a model into unique
+ * vertices with one index array.
+ *
+ * model    - initialized GLMmodel structure
+ * mode     - a bitwise OR of values describing what is welded.
+ *            GLM_NONE    -  weld only vertices
+ *            GLM_SMOOTH  -  weld vertex normals
+ *            GLM_TEXTURE -  weld texture coords
+ */
+GLMindexed*
+glmIndexed(GLMmodel* model, GLuint mode)
+{
+    GLMindexed* indexed;
+    GLuint* table;
+    GLuint  size, mask, slot, i, j, u, v, n, t;
+    
+    assert(model);
+    assert(model->vertices);
+    
+    /* do a bit of warning */
+    if (mode & GLM_SMOOTH && !model->normals) {
+        printf("glmIndexed() warning: smooth normals requested "
+            "with no normals defined.\n");
+        mode &= ~GLM_SMOOTH;
+    }
+    if (mode & GLM_TEXTURE && !model->texcoords) {
+        printf("glmIndexed() warning: texture coordinates requested "
+            "with no texture coordinates defined.\n");
+        mode &= ~GLM_TEXTURE;
+    }
+    
+    indexed = (GLMindexed*)malloc(sizeof(GLMindexed));
+    indexed->numindices = 3 * model->numtriangles;
+    indexed->indices = (GLuint*)malloc(sizeof(GLuint) * indexed->numindices);
+    
+    /* at most one unique vertex per corner */
+    indexed->vindices = (GLuint*)malloc(sizeof(GLuint) * indexed->numindices);
+    indexed->nindices = (GLuint*)malloc(sizeof(GLuint) * indexed->numindices);
+    indexed->tindices = (GLuint*)malloc(sizeof(GLuint) * indexed->numindices);
+    
+    /* open addressing table of unique vertices, at most half full */
+    size = 1;
+    while (size < 2 * indexed->numindices)
+        size <<= 1;
+    mask = size - 1;
+    table = (GLuint*)malloc(sizeof(GLuint) * size);
+    for (slot = 0; slot < size; slot++)
+        table[slot] = (GLuint)-1;
+    
+    indexed->numvertices = 0;
+    for (i = 0; i < model->numtriangles; i++) {
+        for (j = 0; j < 3; j++) {
+            v = T(i).vindices[j];
+            n = mode & GLM_SMOOTH ? T(i).nindices[j] : 0;
+            t = mode & GLM_TEXTURE ? T(i).tindices[j] : 0;
+            
+            slot = glmIndexedHash(v, n, t, mask);
+            while ((u = table[slot]) != (GLuint)-1) {
+                if (indexed->vindices[u] == v && indexed->nindices[u] == n &&
+                    indexed->tindices[u] == t)
+                    break;
+                slot = (slot + 1) & mask;
+            }
+            if (u == (GLuint)-1) {
+                u = indexed->numvertices++;
+                indexed->vindices[u] = v;
+                indexed->nindices[u] = n;
+                indexed->tindices[u] = t;
+                table[slot] = u;
+            }
+            indexed->indices[3 * i + j] = u;
+        }
+    }
+    free(table);
+    
+    indexed->vertices = (GLfloat*)malloc(sizeof(GLfloat) * 3 * indexed->numvertices);
+    indexed->normals = NULL;
+    if (mode & GLM_SMOOTH)
+        indexed->normals = (GLfloat*)malloc(sizeof(GLfloat) * 3 * indexed->numvertices);
+    indexed->texcoords = NULL;
+    if (mode & GLM_TEXTURE) {
+        indexed->texcoords = (GLfloat*)malloc(sizeof(GLfloat) * 2 * indexed->numvertices);
+        for (u = 0; u < indexed->numvertices; u++) {
+            indexed->texcoords[2 * u + 0] = model->texcoords[2 * indexed->tindices[u] + 0];
+            indexed->texcoords[2 * u + 1] = model->texcoords[2 * indexed->tindices[u] + 1];
+        }
+    }
+    glmIndexedUpdate(indexed, model);
+    
+#if 0
+    printf("glmIndexed(): %d corners welded into %d vertices\n",
+        indexed->numindices, indexed->numvertices);
+#endif
+    
+    return indexed;
+}
+
+/* glmIndexedUpdate: Copies the current model vertices (and normals)
+ * into the unique vertices.
+ *
+ * indexed  - structure created with glmIndexed()
+ * model    - the model it was created from
+ */
+GLvoid
+glmIndexedUpdate(GLMindexed* indexed, GLMmodel* model)
+{
+    GLuint u;
+    
+    assert(indexed);
+    assert(model);
+    
+    for (u = 0; u < indexed->numvertices; u++) {
+        indexed->vertices[3 * u + 0] = model->vertices[3 * indexed->vindices[u] + 0];
+        indexed->vertices[3 * u + 1] = model->vertices[3 * indexed->vindices[u] + 1];
+        indexed->vertices[3 * u + 2] = model->vertices[3 * indexed->vindices[u] + 2];
+    }
+    if (indexed->normals) {
+        for (u = 0; u < indexed->numvertices; u++) {
+            indexed->normals[3 * u + 0] = model->normals[3 * indexed->nindices[u] + 0];
+            indexed->normals[3 * u + 1] = model->normals[3 * indexed->nindices[u] + 1];
+            indexed->normals[3 * u + 2] = model->normals[3 * indexed->nindices[u] + 2];
+        }
+    }
+}
+
+/* glmDrawIndexed: Renders the unique vertices with vertex arrays.
+ *
+ * indexed  - structure created with glmIndexed()
+ */
+GLvoid
+glmDrawIndexed(GLMindexed* indexed)
+{
+    assert(indexed);
+    
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, indexed->vertices);
+    if (indexed->normals) {
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glNormalPointer(GL_FLOAT, 0, indexed->normals);
+    }
+    if (indexed->texcoords) {
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glTexCoordPointer(2, GL_FLOAT, 0, indexed->texcoords);
+    }
+    
+    glDrawElements(GL_TRIANGLES, indexed->numindices, GL_UNSIGNED_INT,
+        indexed->indices);
+    
+    glDisableClientState(GL_VERTEX_ARRAY);
+    if (indexed->normals)
+        glDisableClientState(GL_NORMAL_ARRAY);
+    if (indexed->texcoords)
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+}
+
+/* glmBuffers: Creates GL buffer objects for a welded model.
+ *
+ * indexed  - structure created with glmIndexed()
+ */
+GLMbuffers*
+glmBuffers(GLMindexed* indexed)
+{
+    GLMbuffers* buffers;
+    
+    assert(indexed);
+    
+    buffers = (GLMbuffers*)malloc(sizeof(GLMbuffers));
+    buffers->numvertices = indexed->numvertices;
+    buffers->numindices = indexed->numindices;
+    buffers->normals = indexed->normals ? GL_TRUE : GL_FALSE;
+    
+    /* the topology never changes */
+    glGenBuffers(1, &buffers->indexbuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers->indexbuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indexed->numindices,
+        indexed->indices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    
+    buffers->texcoordbuffer = 0;
+    if (indexed->texcoords) {
+        glGenBuffers(1, &buffers->texcoordbuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, buffers->texcoordbuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 2 * indexed->numvertices,
+            indexed->texcoords, GL_STATIC_DRAW);
+    }
+    
+    glGenBuffers(1, &buffers->streambuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glmBuffersUpdate(buffers, indexed);
+    
+    return buffers;
+}
+
+/* glmBuffersUpdate: Streams the current positions and normals of a
+ * welded model into its buffers.
+ *
+ * buffers  - structure created with glmBuffers()
+ * indexed  - the welded model the buffers were created from
+ */
+GLvoid
+glmBuffersUpdate(GLMbuffers* buffers, GLMindexed* indexed)
+{
+    GLsizeiptr size;
+    
+    assert(buffers);
+    assert(indexed);
+    assert(buffers->numvertices == indexed->numvertices);
+    
+    size = sizeof(GLfloat) * 3 * indexed->numvertices;
+    
+    /* orphan the old storage so the driver does not have to wait for
+       draws still reading last frame's vertices */
+    glBindBuffer(GL_ARRAY_BUFFER, buffers->streambuffer);
+    glBufferData(GL_ARRAY_BUFFER, buffers->normals ? 2 * size : size, NULL,
+        GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, indexed->vertices);
+    if (buffers->normals)
+        glBufferSubData(GL_ARRAY_BUFFER, size, size, indexed->normals);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/* glmDrawBuffers: Renders a model from its buffer objects.
+ *
+ * buffers  - structure created with glmBuffers()
+ */
+GLvoid
+glmDrawBuffers(GLMbuffers* buffers)
+{
+    assert(buffers);
+    
+    glBindBuffer(GL_ARRAY_BUFFER, buffers->streambuffer);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, (GLvoid*)0);
+    if (buffers->normals) {
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glNormalPointer(GL_FLOAT, 0,
+            (GLvoid*)(sizeof(GLfloat) * 3 * buffers->numvertices));
+    }
+    if (buffers->texcoordbuffer) {
+        glBindBuffer(GL_ARRAY_BUFFER, buffers->texcoordbuffer);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glTexCoordPointer(2, GL_FLOAT, 0, (GLvoid*)0);
+    }
+    
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers->indexbuffer);
+    glDrawElements(GL_TRIANGLES, buffers->numindices, GL_UNSIGNED_INT, (GLvoid*)0);
+    
+    glDisableClientState(GL_VERTEX_ARRAY);
+    if (buffers->normals)
+        glDisableClientState(GL_NORMAL_ARRAY);
+    if (buffers->texcoordbuffer)
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/* glmBuffersDelete: Deletes a GLMbuffers structure and its buffer
+ * objects.
+ *
+ * buffers  - structure created with glmBuffers()
+ */
+GLvoid
+glmBuffersDelete(GLMbuffers* buffers)
+{
+    assert(buffers);
+    
+    glDeleteBuffers(1, &buffers->indexbuffer);
+    glDeleteBuffers(1, &buffers->streambuffer);
+    if (buffers->texcoordbuffer)
+        glDeleteBuffers(1, &buffers->texcoordbuffer);
+    free(buffers);
+}
+
+/* glmIndexedDelete: Deletes a GLMindexed structure.
+ *
+ * indexed  - structure created with glmIndexed()
+ */
+GLvoid
+glmIndexedDelete(GLMindexed* indexed)
+{
+    assert(indexed);
+    
+    free(indexed->vertices);
+    if (indexed->normals)   free(indexed->normals);
+    if (indexed->texcoords) free(indexed->texcoords);
+    free(indexed->vindices);
+    free(indexed->nindices);
+    free(indexed->tindices);
+    free(indexed->indices);
+    free(indexed);
+}
+
 /* glmReadPPM: read a PPM raw (type P6) file.  The PPM file has a header
  * that should look something like:
  *
@@ -14,8 +14,20 @@
 
  */
 
+#ifndef GLM_H
+#define GLM_H
 
+#include <stddef.h>
+#ifdef __APPLE__
 #include <GLUT/glut.h>
+#else
+/* headless builds (see batch.cpp) only need GL itself */
+#ifndef GL_GLEXT_PROTOTYPES
+#define GL_GLEXT_PROTOTYPES
+#endif
+#include <GL/gl.h>
+#include <GL/glext.h>
+#endif
 
 
 #ifndef M_PI
@@ -74,6 +86,11 @@ typedef struct _GLMgroup {
   struct _GLMgroup* next;           /* pointer to next group in model */
 } GLMgroup;
 
+/* GLMarena: Block allocator that can own all the memory of a model
+ * (see glmReadOBJ()).
+ */
+typedef struct _GLMarena GLMarena;
+
 /* GLMmodel: Structure that defines a model.
  */
 typedef struct _GLMmodel {
@@ -107,8 +124,39 @@ typedef struct _GLMmodel {
 
   GLfloat position[3];          /* position of the model */
 
+  GLMarena*    arena;           /* arena the model memory comes from, or NULL */
+
 } GLMmodel;
 
+/* GLMindexed: Structure that defines a model welded into unique
+ * vertices that share a single index array (see glmIndexed()).
+ */
+typedef struct _GLMindexed {
+  GLuint   numvertices;         /* number of unique vertices */
+  GLfloat* vertices;            /* array of positions (3 per vertex) */
+  GLfloat* normals;             /* array of normals (3 per vertex) or NULL */
+  GLfloat* texcoords;           /* array of texcoords (2 per vertex) or NULL */
+
+  GLuint*  vindices;            /* model vertex of each unique vertex */
+  GLuint*  nindices;            /* model normal of each unique vertex */
+  GLuint*  tindices;            /* model texcoord of each unique vertex */
+
+  GLuint   numindices;          /* number of indices (3 per triangle) */
+  GLuint*  indices;             /* array of unique vertex indices */
+} GLMindexed;
+
+/* GLMbuffers: Structure that defines the GL buffer objects holding a
+ * welded model (see glmBuffers()).
+ */
+typedef struct _GLMbuffers {
+  GLuint   numvertices;         /* number of vertices in the buffers */
+  GLuint   numindices;          /* number of indices in the index buffer */
+  GLuint   indexbuffer;         /* static element array buffer */
+  GLuint   streambuffer;        /* positions, then normals, rewritten per frame */
+  GLuint   texcoordbuffer;      /* static texcoord buffer, or 0 */
+  GLboolean normals;            /* whether streambuffer holds normals */
+} GLMbuffers;
+
 struct mycallback
 {
 	void (*loadcallback)(int,char *);
@@ -221,8 +269,41 @@ glmDelete(GLMmodel* model);
  * filename - name of the file containing the Wavefront .OBJ format data.
  */
 //GLMmodel * glmReadOBJ(char* filename);
-GLMmodel* glmReadOBJ(char* filename);
-GLMmodel* glmReadOBJ(char* filename,mycallback *call);
+GLMmodel* glmReadOBJ(const char* filename);
+GLMmodel* glmReadOBJ(const char* filename,mycallback *call);
+
+/* glmReadOBJ: Same as above, but if arena is GL_TRUE every allocation
+ * owned by the model (names, groups, materials, textures, vertex and
+ * triangle arrays, generated normals) is carved out of a few large
+ * blocks, and glmDelete() releases the blocks instead of walking the
+ * model.
+ *
+ * filename - name of the file containing the Wavefront .OBJ format data.
+ * call     - loading progress callback, or NULL
+ * arena    - GL_TRUE to allocate the model from an arena
+ */
+GLMmodel* glmReadOBJ(const char* filename,mycallback *call,GLboolean arena);
+
+/* glmMalloc: Allocates memory owned by a model, from its arena if it
+ * has one.  Routines outside glm that replace model arrays (such as
+ * model->normals) must use glmMalloc() and glmFree().
+ *
+ * model - initialized GLMmodel structure
+ * size  - number of bytes
+ */
+GLvoid*
+glmMalloc(GLMmodel* model, size_t size);
+
+/* glmFree: Releases memory allocated with glmMalloc().  Memory from an
+ * arena goes back to the arena, for later glmMalloc() calls of the same
+ * size or less (arrays regenerated in place), and to the system only
+ * when the model is deleted.
+ *
+ * model - initialized GLMmodel structure
+ * ptr   - memory allocated with glmMalloc(), or NULL
+ */
+GLvoid
+glmFree(GLMmodel* model, GLvoid* ptr);
 
 /* glmWriteOBJ: Writes a model description in Wavefront .OBJ format to
  * a file.
@@ -278,6 +359,84 @@ glmList(GLMmodel* model, GLuint mode);
 GLvoid
 glmWeld(GLMmodel* model, GLfloat epsilon);
 
+/* glmIndexed: Welds the triangle corners of a model into unique
+ * vertices with one index array, for indexed rendering.  Corners are
+ * merged when they share the same model vertex, normal and texcoord,
+ * so every unique vertex maps back to one model vertex and
+ * deformations can be applied with glmIndexedUpdate().  Returns a
+ * pointer to the created structure which should be free'd with
+ * glmIndexedDelete().
+ *
+ * model    - initialized GLMmodel structure
+ * mode     - a bitwise OR of values describing what is welded.
+ *            GLM_NONE    -  weld only vertices
+ *            GLM_SMOOTH  -  weld vertex normals
+ *            GLM_TEXTURE -  weld texture coords
+ */
+GLMindexed*
+glmIndexed(GLMmodel* model, GLuint mode);
+
+/* glmIndexedUpdate: Copies the current model vertices (and normals)
+ * into the unique vertices, after the model has been deformed.
+ *
+ * indexed  - structure created with glmIndexed()
+ * model    - the model it was created from
+ */
+GLvoid
+glmIndexedUpdate(GLMindexed* indexed, GLMmodel* model);
+
+/* glmDrawIndexed: Renders the unique vertices with vertex arrays and
+ * a single glDrawElements().
+ *
+ * indexed  - structure created with glmIndexed()
+ */
+GLvoid
+glmDrawIndexed(GLMindexed* indexed);
+
+/* glmBuffers: Creates GL buffer objects for a welded model.  The
+ * topology (indices) and texcoords go into static buffers once; the
+ * positions and normals go into a stream buffer that glmBuffersUpdate()
+ * rewrites after every deformation.  Requires a current GL context.
+ * Returns a pointer to the created structure which should be free'd
+ * with glmBuffersDelete().
+ *
+ * indexed  - structure created with glmIndexed()
+ */
+GLMbuffers*
+glmBuffers(GLMindexed* indexed);
+
+/* glmBuffersUpdate: Streams the current positions and normals of a
+ * welded model into its buffers.
+ *
+ * buffers  - structure created with glmBuffers()
+ * indexed  - the welded model the buffers were created from
+ */
+GLvoid
+glmBuffersUpdate(GLMbuffers* buffers, GLMindexed* indexed);
+
+/* glmDrawBuffers: Renders a model from its buffer objects with a
+ * single glDrawElements().
+ *
+ * buffers  - structure created with glmBuffers()
+ */
+GLvoid
+glmDrawBuffers(GLMbuffers* buffers);
+
+/* glmBuffersDelete: Deletes a GLMbuffers structure and its buffer
+ * objects.
+ *
+ * buffers  - structure created with glmBuffers()
+ */
+GLvoid
+glmBuffersDelete(GLMbuffers* buffers);
+
+/* glmIndexedDelete: Deletes a GLMindexed structure.
+ *
+ * indexed  - structure created with glmIndexed()
+ */
+GLvoid
+glmIndexedDelete(GLMindexed* indexed);
+
 /* glmReadPPM: read a PPM raw (type P6) file.  The PPM file has a header
  * that should look something like:
  *
@@ -310,4 +469,6 @@ GLubyte*
 glmReadPPM(char* filename, int* width, int* height);
 
 GLMgroup*
-glmFindGroup(GLMmodel* model, char* name);
+glmFindGroup(GLMmodel* model, const char* name);
+
+#endif
@@ -0,0 +1,225 @@
+/*
+      halfedge.cpp
+
+      Half-edge connectivity for the triangles of a GLMmodel.
+
+      Twins are found with an open addressing hash table keyed on the
+      directed edge (origin, target): every half-edge is inserted once
+      and then looks up its reverse, so the build is linear in the
+      number of triangles.
+*/
+
+#include <stdlib.h>
+#include <assert.h>
+#include "halfedge.h"
+
+
+#define T(x) (model->triangles[(x)])
+
+
+/* heHash: hash of a directed edge */
+static GLuint
+heHash(GLuint from, GLuint to, GLuint mask)
+{
+    return ((from * 2654435761u) ^ (to * 2246822519u)) & mask;
+}
+
+/* heLookup: find the first half-edge from -> to in the table, or
+ * HE_NONE
+ */
+static GLuint
+heLookup(GLMmodel* model, GLuint* table, GLuint mask, GLuint from, GLuint to)
+{
+    GLuint slot, h;
+
+    slot = heHash(from, to, mask);
+    while ((h = table[slot]) != HE_NONE) {
+        if (T(h / 3).vindices[h % 3] == from &&
+            T(h / 3).vindices[(h + 1) % 3] == to)
+            return h;
+        slot = (slot + 1) & mask;
+    }
+    return HE_NONE;
+}
+
+
+/* public functions */
+
+
+/* heBuild: Builds the connectivity of a model in linear time.
+ *
+ * model - initialized GLMmodel structure
+ */
+HEmesh*
+heBuild(GLMmodel* model)
+{
+    HEmesh* mesh;
+    GLuint* table;
+    GLuint  size, mask, slot, h, o, v, from, to;
+
+    assert(model);
+
+    mesh = (HEmesh*)malloc(sizeof(HEmesh));
+    mesh->numvertices = model->numvertices;
+    mesh->numhalfedges = 3 * model->numtriangles;
+    mesh->twin = (GLuint*)malloc(sizeof(GLuint) * (mesh->numhalfedges + 1));
+    mesh->outgoing = (GLuint*)malloc(sizeof(GLuint) * (mesh->numvertices + 1));
+
+    for (v = 0; v <= mesh->numvertices; v++)
+        mesh->outgoing[v] = HE_NONE;
+
+    /* table at most half full */
+    size = 1;
+    while (size < 2 * mesh->numhalfedges)
+        size <<= 1;
+    mask = size - 1;
+    table = (GLuint*)malloc(sizeof(GLuint) * size);
+    for (slot = 0; slot < size; slot++)
+        table[slot] = HE_NONE;
+
+    /* insert every directed edge (duplicates keep the first one) */
+    for (h = 0; h < mesh->numhalfedges; h++) {
+        from = heOrigin(model, h);
+        to = heTarget(model, h);
+        mesh->twin[h] = HE_NONE;
+        if (heLookup(model, table, mask, from, to) != HE_NONE)
+            continue;
+        slot = heHash(from, to, mask);
+        while (table[slot] != HE_NONE)
+            slot = (slot + 1) & mask;
+        table[slot] = h;
+    }
+
+    /* pair every half-edge with its reverse */
+    for (h = 0; h < mesh->numhalfedges; h++) {
+        if (mesh->twin[h] != HE_NONE)
+            continue;
+        o = heLookup(model, table, mask, heTarget(model, h), heOrigin(model, h));
+        if (o != HE_NONE && o != h && mesh->twin[o] == HE_NONE) {
+            mesh->twin[h] = o;
+            mesh->twin[o] = h;
+        }
+    }
+    free(table);
+
+    /* one outgoing half-edge per vertex, preferring the boundary so
+       that walking the fan counter-clockwise visits all of it */
+    for (h = 0; h < mesh->numhalfedges; h++) {
+        v = heOrigin(model, h);
+        if (mesh->outgoing[v] == HE_NONE || mesh->twin[h] == HE_NONE)
+            mesh->outgoing[v] = h;
+    }
+
+    /* store the neighbours in the triangles */
+    for (h = 0; h < mesh->numhalfedges; h++)
+        T(h / 3).vecini[h % 3] = mesh->twin[h] == HE_NONE ? HE_NONE : mesh->twin[h] / 3;
+
+    return mesh;
+}
+
+/* heNeighbor: Returns the triangle across an edge of a triangle.
+ *
+ * mesh     - connectivity built with heBuild()
+ * triangle - index of the triangle
+ * edge     - edge of the triangle (0, 1 or 2)
+ */
+GLuint
+heNeighbor(HEmesh* mesh, GLuint triangle, GLuint edge)
+{
+    GLuint twin;
+
+    assert(mesh);
+    assert(edge < 3);
+
+    twin = mesh->twin[3 * triangle + edge];
+    return twin == HE_NONE ? HE_NONE : twin / 3;
+}
+
+/* heOneRing: Collects the vertices adjacent to a vertex.
+ *
+ * mesh   - connectivity built with heBuild()
+ * model  - the model the connectivity was built for
+ * vertex - index of the vertex
+ * ring   - array of at least max GLuints to return the ring in
+ * max    - size of the ring array
+ */
+GLuint
+heOneRing(HEmesh* mesh, GLMmodel* model, GLuint vertex, GLuint* ring,
+          GLuint max)
+{
+    GLuint start, h, prev, count;
+
+    assert(mesh);
+    assert(model);
+    assert(vertex <= mesh->numvertices);
+
+    count = 0;
+    start = h = mesh->outgoing[vertex];
+    if (start == HE_NONE)
+        return 0;
+
+    do {
+        if (count < max)
+            ring[count] = heTarget(model, h);
+        count++;
+
+        /* the previous half-edge ends at vertex, its twin leaves it
+           in the next triangle of the fan */
+        prev = hePrev(h);
+        h = mesh->twin[prev];
+        if (h == HE_NONE) {
+            /* reached the boundary: the last edge closes the ring */
+            if (count < max)
+                ring[count] = heOrigin(model, prev);
+            count++;
+            break;
+        }
+    } while (h != start && count <= mesh->numhalfedges);
+
+    return count;
+}
+
+/* heIsBoundaryEdge: Returns GL_TRUE if a half-edge has no twin.
+ *
+ * mesh - connectivity built with heBuild()
+ * h    - index of the half-edge
+ */
+GLboolean
+heIsBoundaryEdge(HEmesh* mesh, GLuint h)
+{
+    assert(mesh);
+    assert(h < mesh->numhalfedges);
+
+    return mesh->twin[h] == HE_NONE;
+}
+
+/* heIsBoundaryVertex: Returns GL_TRUE if a vertex lies on the
+ * boundary.
+ *
+ * mesh   - connectivity built with heBuild()
+ * vertex - index of the vertex
+ */
+GLboolean
+heIsBoundaryVertex(HEmesh* mesh, GLuint vertex)
+{
+    assert(mesh);
+    assert(vertex <= mesh->numvertices);
+
+    if (mesh->outgoing[vertex] == HE_NONE)
+        return GL_TRUE;
+    return mesh->twin[mesh->outgoing[vertex]] == HE_NONE;
+}
+
+/* heDelete: Deletes a HEmesh structure.
+ *
+ * mesh - connectivity built with heBuild()
+ */
+GLvoid
+heDelete(HEmesh* mesh)
+{
+    assert(mesh);
+
+    free(mesh->twin);
+    free(mesh->outgoing);
+    free(mesh);
+}
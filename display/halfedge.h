@@ -0,0 +1,116 @@
+/*
+      halfedge.h
+
+      Half-edge connectivity for the triangles of a GLMmodel.
+
+      The half-edges are implicit in the triangle array: half-edge
+      3 * t + k runs from T(t).vindices[k] to T(t).vindices[(k + 1) % 3],
+      so next, prev and face are plain arithmetic and only the twin of
+      each half-edge and one outgoing half-edge per vertex are stored.
+
+      Usage:
+
+      o  call heBuild() once the triangles are loaded; it also fills in
+         the vecini[] (neighbour) field of every GLMtriangle
+      o  call heNeighbor(), heOneRing(), heIsBoundaryEdge() and
+         heIsBoundaryVertex() for topology queries
+      o  call heDelete() when done
+
+      Edges shared by more than two triangles, or by two triangles with
+      opposite winding, are treated as boundary edges.  Vertices whose
+      triangles form several separate fans only report one of them.
+
+ */
+
+#ifndef HALFEDGE_H
+#define HALFEDGE_H
+
+#include "glm.h"
+
+
+#define HE_NONE ((GLuint)-1)    /* no half-edge (boundary / isolated vertex) */
+
+
+/* HEmesh: Structure that defines the connectivity of a model.
+ */
+typedef struct _HEmesh {
+  GLuint  numvertices;          /* number of vertices in model */
+  GLuint  numhalfedges;         /* number of half-edges (3 per triangle) */
+  GLuint* twin;                 /* opposite half-edge or HE_NONE, per half-edge */
+  GLuint* outgoing;             /* one outgoing half-edge per vertex (1-based,
+                                   a boundary one if the vertex is on the
+                                   boundary), HE_NONE if unused */
+} HEmesh;
+
+
+/* heNext, hePrev, heFace: half-edge arithmetic */
+static inline GLuint heNext(GLuint h) { return h - h % 3 + (h + 1) % 3; }
+static inline GLuint hePrev(GLuint h) { return h - h % 3 + (h + 2) % 3; }
+static inline GLuint heFace(GLuint h) { return h / 3; }
+
+/* heOrigin, heTarget: vertex a half-edge starts / ends at */
+static inline GLuint heOrigin(GLMmodel* model, GLuint h)
+{ return model->triangles[h / 3].vindices[h % 3]; }
+static inline GLuint heTarget(GLMmodel* model, GLuint h)
+{ return model->triangles[h / 3].vindices[(h + 1) % 3]; }
+
+
+/* heBuild: Builds the connectivity of a model in linear time, and
+ * stores the neighbour of every triangle edge in vecini[] (-1 on the
+ * boundary).  Returns a pointer to the created structure which should
+ * be free'd with heDelete().
+ *
+ * model - initialized GLMmodel structure
+ */
+HEmesh*
+heBuild(GLMmodel* model);
+
+/* heNeighbor: Returns the triangle across edge k (vindices[k] to
+ * vindices[(k + 1) % 3]) of triangle t, or HE_NONE on the boundary.
+ *
+ * mesh     - connectivity built with heBuild()
+ * triangle - index of the triangle
+ * edge     - edge of the triangle (0, 1 or 2)
+ */
+GLuint
+heNeighbor(HEmesh* mesh, GLuint triangle, GLuint edge);
+
+/* heOneRing: Collects the vertices adjacent to a vertex, in
+ * counter-clockwise order.  Returns the number of vertices in the
+ * ring, which may be larger than max (only max are stored).
+ *
+ * mesh   - connectivity built with heBuild()
+ * model  - the model the connectivity was built for
+ * vertex - index of the vertex
+ * ring   - array of at least max GLuints to return the ring in
+ * max    - size of the ring array
+ */
+GLuint
+heOneRing(HEmesh* mesh, GLMmodel* model, GLuint vertex, GLuint* ring,
+          GLuint max);
+
+/* heIsBoundaryEdge: Returns GL_TRUE if a half-edge has no twin.
+ *
+ * mesh - connectivity built with heBuild()
+ * h    - index of the half-edge
+ */
+GLboolean
+heIsBoundaryEdge(HEmesh* mesh, GLuint h);
+
+/* heIsBoundaryVertex: Returns GL_TRUE if a vertex lies on the
+ * boundary (or is not used by any triangle).
+ *
+ * mesh   - connectivity built with heBuild()
+ * vertex - index of the vertex
+ */
+GLboolean
+heIsBoundaryVertex(HEmesh* mesh, GLuint vertex);
+
+/* heDelete: Deletes a HEmesh structure.
+ *
+ * mesh - connectivity built with heBuild()
+ */
+GLvoid
+heDelete(HEmesh* mesh);
+
+#endif
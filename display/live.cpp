@@ -0,0 +1,388 @@
+/*
+      live.cpp
+
+      Live weight frames pushed by an external producer.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "live.h"
+
+
+#define LV_SLOT(x) ((x) & (LV_RINGSIZE - 1))
+
+
+/* lvPush: push a frame into the ring, or drop it if the ring is full */
+static GLvoid
+lvPush(LVstream* stream, GLdouble time, GLdouble arrival, GLfloat* frame)
+{
+    GLuint head, slot;
+
+    /* a full ring drops the frame rather than wait for the renderer,
+       which skips stale frames anyway */
+    head = stream->head;
+    if (head - __atomic_load_n(&stream->tail, __ATOMIC_ACQUIRE) == LV_RINGSIZE) {
+        __atomic_fetch_add(&stream->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    slot = LV_SLOT(head);
+    stream->times[slot] = time;
+    stream->arrivals[slot] = arrival;
+    memcpy(&stream->frames[stream->numtracks * slot], frame, sizeof(GLfloat) * stream->numtracks);
+    __atomic_store_n(&stream->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/* lvFiltered: push the frames the filter wrote for a record; frame k
+ * of n is timed k - n + factor steps after the record, and counts as
+ * arriving that much later, so every frame shows the record's delay
+ */
+static GLvoid
+lvFiltered(LVstream* stream, GLdouble time, GLdouble arrival, GLuint n)
+{
+    GLdouble offset;
+    GLuint k;
+
+    for (k = 0; k < n; k++) {
+        offset = ((GLdouble)k - n + stream->filter->factor) * stream->step;
+        lvPush(stream, time + offset, arrival + offset, &stream->filtered[stream->numtracks * k]);
+    }
+}
+
+/* lvRead: read a whole record, polling the source and the wake pipe
+ *
+ * returns GL_FALSE at the end of the source, or once lvDelete() has
+ * woken the reader
+ */
+static GLboolean
+lvRead(LVstream* stream, int file, GLuint size)
+{
+    struct pollfd fds[2];
+    GLuint got;
+    ssize_t count;
+
+    fds[0].fd = file;
+    fds[0].events = POLLIN;
+    fds[1].fd = stream->wake[0];
+    fds[1].events = POLLIN;
+    for (got = 0; got < size; got += count) {
+        count = 0;
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            return GL_FALSE;
+        }
+        if (fds[1].revents || __atomic_load_n(&stream->quit, __ATOMIC_ACQUIRE))
+            return GL_FALSE;
+        count = read(file, stream->record + got, size - got);
+        if (count < 0 && errno == EINTR)
+            count = 0;
+        else if (count <= 0)
+            return GL_FALSE;
+    }
+    return GL_TRUE;
+}
+
+/* lvReader: thread function reading records into the ring */
+static GLvoid*
+lvReader(GLvoid* data)
+{
+    LVstream* stream = (LVstream*)data;
+    GLfloat* frame;
+    GLdouble time, arrival;
+    GLuint size, n;
+    GLboolean first;
+    int file;
+
+    /* the descriptor is published before opened, which lvDelete()
+       waits for, so it is closed however the reader ends */
+    file = stream->file;
+    if (file < 0) {
+        file = open(stream->source, O_RDONLY);
+        __atomic_store_n(&stream->file, file, __ATOMIC_RELEASE);
+        __atomic_store_n(&stream->opened, 1, __ATOMIC_RELEASE);
+        if (file < 0) {
+            fprintf(stderr, "lvOpen() failed: can't open \"%s\".\n", stream->source);
+            __atomic_store_n(&stream->closed, 1, __ATOMIC_RELEASE);
+            return NULL;
+        }
+    }
+
+    size = sizeof(GLdouble) + sizeof(GLfloat) * stream->numtracks;
+    frame = (GLfloat*)(stream->record + sizeof(GLdouble));
+    first = GL_TRUE;
+    while (lvRead(stream, file, size)) {
+        arrival = lvClock();
+        memcpy(&time, stream->record, sizeof(GLdouble));
+
+        if (!stream->filter) {
+            lvPush(stream, time, arrival, frame);
+            continue;
+        }
+        if (!first)
+            stream->step = (time - stream->lasttime) / stream->filter->factor;
+        stream->lasttime = time;
+        first = GL_FALSE;
+        n = flPush(stream->filter, frame, stream->filtered);
+        lvFiltered(stream, time, arrival, n);
+    }
+
+    /* the end the filter held back */
+    if (stream->filter && !__atomic_load_n(&stream->quit, __ATOMIC_ACQUIRE)) {
+        n = flFlush(stream->filter, stream->filtered);
+        lvFiltered(stream, stream->lasttime + stream->filter->factor * stream->step,
+            lvClock(), n);
+    }
+    __atomic_store_n(&stream->closed, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+
+/* public functions */
+
+
+/* lvClock: Monotonic milliseconds, the clock arrivals are stamped
+ * with.
+ */
+GLdouble
+lvClock(GLvoid)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000.0 + t.tv_nsec * 1e-6;
+}
+
+/* lvOpen: Starts reading frames from a source.
+ *
+ * source    - "-" for stdin, or the path of a pipe, FIFO, Unix socket
+ *             or file
+ * numtracks - weights per frame (numtracks of the tracks it replaces)
+ * jitter    - ms the frames are played behind their arrival
+ * filter    - filter with numtracks channels the reader runs the
+ *             frames through until lvDelete(), or NULL
+ */
+LVstream*
+lvOpen(const char* source, GLuint numtracks, GLdouble jitter, FLfilter* filter)
+{
+    LVstream* stream;
+    struct stat status;
+    struct sockaddr_un address;
+    int file;
+
+    assert(source);
+    assert(numtracks > 0);
+    assert(!filter || filter->numchannels == numtracks);
+
+    /* sockets are connected here; anything else is opened by the
+       reader, since opening a FIFO waits for its writer */
+    file = -1;
+    if (!strcmp(source, "-"))
+        file = STDIN_FILENO;
+    else if (stat(source, &status) < 0) {
+        fprintf(stderr, "lvOpen() failed: can't open \"%s\".\n", source);
+        return NULL;
+    } else if (S_ISSOCK(status.st_mode)) {
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, source, sizeof(address.sun_path) - 1);
+        file = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (file < 0 || connect(file, (struct sockaddr*)&address, sizeof(address)) < 0) {
+            fprintf(stderr, "lvOpen() failed: can't connect to \"%s\".\n", source);
+            if (file >= 0)
+                close(file);
+            return NULL;
+        }
+    }
+
+    stream = (LVstream*)malloc(sizeof(LVstream));
+    if (pipe(stream->wake) < 0) {
+        fprintf(stderr, "lvOpen() failed: can't create the wake pipe.\n");
+        if (file >= 0 && file != STDIN_FILENO)
+            close(file);
+        free(stream);
+        return NULL;
+    }
+    stream->numtracks = numtracks;
+    stream->jitter = jitter;
+    stream->source = strdup(source);
+    stream->file = file;
+    stream->opened = file >= 0;
+    stream->quit = 0;
+    stream->record = (GLubyte*)malloc(sizeof(GLdouble) + sizeof(GLfloat) * numtracks);
+    stream->filter = filter;
+    stream->filtered = filter ?
+        (GLfloat*)malloc(sizeof(GLfloat) * numtracks * flMaxSamples(filter)) : NULL;
+    stream->lasttime = 0.0;
+    stream->step = 0.0;
+    stream->times = (GLdouble*)malloc(sizeof(GLdouble) * LV_RINGSIZE);
+    stream->arrivals = (GLdouble*)malloc(sizeof(GLdouble) * LV_RINGSIZE);
+    stream->frames = (GLfloat*)malloc(sizeof(GLfloat) * numtracks * LV_RINGSIZE);
+    stream->head = stream->tail = 0;
+    stream->closed = 0;
+    stream->dropped = 0;
+
+    stream->seen = 0;
+    stream->delay = 1e30;
+    stream->clock = 0.0;
+    stream->started = GL_FALSE;
+    stream->previoustime = 0.0;
+    stream->previousarrival = 0.0;
+    stream->previous = (GLfloat*)malloc(sizeof(GLfloat) * numtracks);
+    stream->latency = 0.0;
+
+    if (pthread_create(&stream->thread, NULL, lvReader, stream) != 0) {
+        fprintf(stderr, "lvOpen() failed: can't start the reader thread.\n");
+        stream->thread = pthread_self();
+        lvDelete(stream);
+        return NULL;
+    }
+
+    return stream;
+}
+
+/* lvWeights: Evaluates the basis weights at the play point.
+ *
+ * stream  - structure created with lvOpen()
+ * tracks  - tracks whose correspond_sequence maps the frames
+ * gains   - array of numselected GLfloats
+ * weights - array of numselected GLfloats to write the weights to
+ */
+GLboolean
+lvWeights(LVstream* stream, SQtracks* tracks, GLfloat* gains, GLfloat* weights)
+{
+    GLfloat* next;
+    GLdouble now, play, arrival;
+    GLfloat t, p;
+    GLuint head, tail, slot, k;
+
+    assert(stream);
+    assert(tracks);
+    assert(tracks->numtracks == stream->numtracks);
+
+    now = lvClock();
+    head = __atomic_load_n(&stream->head, __ATOMIC_ACQUIRE);
+    tail = stream->tail;
+
+    /* the transport delay is the smallest seen; it creeps up so that
+       a producer clock running slower than ours is followed */
+    if (stream->started)
+        stream->delay += (now - stream->clock) * LV_DRIFT;
+    stream->clock = now;
+    for (; stream->seen != head; stream->seen++) {
+        slot = LV_SLOT(stream->seen);
+        if (stream->arrivals[slot] - stream->times[slot] < stream->delay)
+            stream->delay = stream->arrivals[slot] - stream->times[slot];
+    }
+    if (!stream->started && tail == head)
+        return GL_FALSE;
+
+    /* consume the frames up to the play point */
+    play = now - stream->delay - stream->jitter;
+    while (tail != head && stream->times[LV_SLOT(tail)] <= play) {
+        slot = LV_SLOT(tail);
+        memcpy(stream->previous, &stream->frames[stream->numtracks * slot],
+            sizeof(GLfloat) * stream->numtracks);
+        stream->previoustime = stream->times[slot];
+        stream->previousarrival = stream->arrivals[slot];
+        stream->started = GL_TRUE;
+        tail++;
+    }
+    __atomic_store_n(&stream->tail, tail, __ATOMIC_RELEASE);
+
+    /* interpolate towards the next frame, or hold the last one */
+    next = NULL;
+    t = 0.0f;
+    arrival = stream->previousarrival;
+    if (tail != head) {
+        slot = LV_SLOT(tail);
+        next = &stream->frames[stream->numtracks * slot];
+        if (!stream->started) {
+            arrival = stream->arrivals[slot];
+            t = 1.0f;
+        }
+        else if (stream->times[slot] > stream->previoustime)
+            t = (GLfloat)((play - stream->previoustime) /
+                (stream->times[slot] - stream->previoustime));
+    }
+    stream->latency = now - arrival;
+
+    for (k = 0; k < tracks->numselected; k++) {
+        p = stream->started ? stream->previous[tracks->selected[k]] : 0.0f;
+        if (next)
+            p += t * (next[tracks->selected[k]] - p);
+        weights[k] = gains[k] * p;
+    }
+
+    return GL_TRUE;
+}
+
+/* lvClosed: Returns GL_TRUE once the source has ended and every frame
+ * has been consumed.
+ *
+ * stream - structure created with lvOpen()
+ */
+GLboolean
+lvClosed(LVstream* stream)
+{
+    assert(stream);
+
+    return __atomic_load_n(&stream->closed, __ATOMIC_ACQUIRE) &&
+        stream->tail == __atomic_load_n(&stream->head, __ATOMIC_ACQUIRE);
+}
+
+/* lvDelete: Stops the reader thread and deletes a LVstream structure.
+ *
+ * stream - structure created with lvOpen()
+ */
+GLvoid
+lvDelete(LVstream* stream)
+{
+    struct timespec pause = { 0, 1000000 };
+    struct stat status;
+    ssize_t count;
+    int file;
+
+    assert(stream);
+
+    if (!pthread_equal(stream->thread, pthread_self())) {
+        __atomic_store_n(&stream->quit, 1, __ATOMIC_RELEASE);
+        count = write(stream->wake[1], "", 1);
+        (void)count;
+
+        /* opening a FIFO waits for a writer, so be one until the
+           reader's open has returned */
+        while (!__atomic_load_n(&stream->opened, __ATOMIC_ACQUIRE)) {
+            if (stat(stream->source, &status) == 0 && S_ISFIFO(status.st_mode)) {
+                file = open(stream->source, O_WRONLY | O_NONBLOCK);
+                if (file >= 0)
+                    close(file);
+            }
+            nanosleep(&pause, NULL);
+        }
+        pthread_join(stream->thread, NULL);
+    }
+    file = __atomic_load_n(&stream->file, __ATOMIC_ACQUIRE);
+    if (file >= 0 && file != STDIN_FILENO)
+        close(file);
+    close(stream->wake[0]);
+    close(stream->wake[1]);
+
+    free(stream->source);
+    free(stream->record);
+    free(stream->filtered);
+    free(stream->times);
+    free(stream->arrivals);
+    free(stream->frames);
+    free(stream->previous);
+    free(stream);
+}
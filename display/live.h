@@ -0,0 +1,144 @@
+/*
+      live.h
+
+      Live weight frames pushed by an external producer, instead of
+      the tracks the model wrote offline.
+
+      The producer writes records to a pipe, a FIFO, a Unix socket or
+      stdin.  A record is one frame of the model's predictions (as
+      packed in sequence.bin, see sequence.h) with a timestamp in front:
+
+          offset  size
+               0     8  time of the frame in ms (double), on any clock
+               8     4  track 0 (float)
+                   ...
+          8+4*n     -   next record
+
+      All fields are little endian.
+
+      A reader thread stamps every record with its arrival, runs it
+      through a filter (filter.h) if there is one, and pushes the
+      frames into a single-producer/single-consumer ring; the producer
+      side only writes head and the render side only writes tail, so
+      neither side waits on the other.  The render thread plays the
+      frames jitter ms behind the earliest arrival seen so far
+      (transport delay is estimated as the smallest arrival minus
+      time, so the two clocks need not agree), interpolating between
+      the two frames around that point.  With a jitter of 0 the
+      newest frame is shown as soon as it arrives.
+
+      The frames a filter writes for a record are timed from the
+      record's timestamp and the interval between records, so a record
+      resampled to several frames is played over that interval.  A FIR
+      filter writes frame j once sample j is in, so it adds no delay
+      beyond its own group delay, which the offline tracks have too.
+
+ */
+
+#ifndef LIVE_H
+#define LIVE_H
+
+#include <pthread.h>
+#include "glm.h"
+#include "sequence.h"
+#include "filter.h"
+
+
+#define LV_RINGSIZE 256         /* frames in the ring, a power of two */
+#define LV_DRIFT 0.001          /* ms per ms the delay estimate relaxes by */
+
+
+/* LVstream: Structure that defines a live source of weight frames.
+ */
+typedef struct _LVstream {
+  GLuint   numtracks;           /* weights per frame */
+  GLdouble jitter;              /* ms the frames are played behind */
+
+  char*    source;              /* path of the source */
+  int      file;                /* descriptor read from, -1 until opened */
+  GLuint   opened;              /* set once the reader is done opening */
+  int      wake[2];             /* pipe the reader polls next to file */
+  GLuint   quit;                /* set to stop the reader */
+  pthread_t thread;             /* reader thread */
+  GLubyte* record;              /* record being read */
+  FLfilter* filter;             /* filter of the frames, or NULL */
+  GLfloat* filtered;            /* frames written by the filter */
+  GLdouble lasttime;            /* timestamp of the previous record */
+  GLdouble step;                /* time between the frames of a record */
+
+  GLdouble* times;              /* LV_RINGSIZE producer timestamps */
+  GLdouble* arrivals;           /* LV_RINGSIZE arrival times (lvClock()),
+                                   plus the offset of a frame in its record */
+  GLfloat*  frames;             /* LV_RINGSIZE frames of numtracks weights */
+  GLuint   head;                /* next slot the reader writes */
+  GLuint   tail;                /* oldest slot not yet consumed */
+  GLuint   closed;              /* set when the source ends */
+  GLuint   dropped;             /* frames dropped on a full ring */
+
+  /* render side */
+  GLuint   seen;                /* slots scanned for the delay */
+  GLdouble delay;               /* smallest arrival - time */
+  GLdouble clock;               /* lvClock() of the last lvWeights() */
+  GLboolean started;            /* previous holds a frame */
+  GLdouble previoustime;        /* timestamp of previous */
+  GLdouble previousarrival;     /* arrival of previous */
+  GLfloat* previous;            /* last frame at or before the play point */
+  GLdouble latency;             /* ms from the arrival of the newest frame
+                                   reached to the last lvWeights() */
+} LVstream;
+
+
+/* lvClock: Monotonic milliseconds, the clock arrivals are stamped
+ * with.
+ */
+GLdouble
+lvClock(GLvoid);
+
+/* lvOpen: Starts reading frames from a source.  A FIFO is opened by
+ * the reader thread, so this does not block until the producer opens
+ * it.  Returns NULL if the source can't be opened, otherwise a
+ * pointer to the created structure which should be free'd with
+ * lvDelete().
+ *
+ * source    - "-" for stdin, or the path of a pipe, FIFO, Unix socket
+ *             or file
+ * numtracks - weights per frame (numtracks of the tracks it replaces)
+ * jitter    - ms the frames are played behind their arrival
+ * filter    - filter with numtracks channels the reader runs the
+ *             frames through until lvDelete(), or NULL
+ */
+LVstream*
+lvOpen(const char* source, GLuint numtracks, GLdouble jitter, FLfilter* filter);
+
+/* lvWeights: Evaluates the basis weights at the play point, the same
+ * way sqWeights() does for a frame of the tracks.  Consumes the frames
+ * before the play point.  Returns GL_FALSE (and leaves weights alone)
+ * until the first frame has arrived.  Only one thread may call it.
+ *
+ * stream  - structure created with lvOpen()
+ * tracks  - tracks whose correspond_sequence maps the frames
+ * gains   - array of numselected GLfloats
+ * weights - array of numselected GLfloats to write the weights to
+ */
+GLboolean
+lvWeights(LVstream* stream, SQtracks* tracks, GLfloat* gains, GLfloat* weights);
+
+/* lvClosed: Returns GL_TRUE once the source has ended and every frame
+ * has been consumed.
+ *
+ * stream - structure created with lvOpen()
+ */
+GLboolean
+lvClosed(LVstream* stream);
+
+/* lvDelete: Stops the reader thread and deletes a LVstream structure.
+ * The reader is woken through a pipe it polls next to the source, and
+ * a FIFO it is still opening is opened for writing so that its open
+ * returns, so the reader is never cancelled and always joined.
+ *
+ * stream - structure created with lvOpen()
+ */
+GLvoid
+lvDelete(LVstream* stream);
+
+#endif
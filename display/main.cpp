@@ -1,11 +1,14 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <math.h>
 #include <vector>
 #include <numeric>
 #include <iostream>
+#include <chrono>
 #include <OpenGL/gl.h>
+#include <OpenGL/OpenGL.h>
 #include <GLUT/glut.h>
 
 #include <OpenAL/al.h>
@@ -13,6 +16,14 @@
 #include <AudioToolbox/AudioToolbox.h>
 
 #include "glm.h"
+#include "bvh.h"
+#include "blend.h"
+#include "morph.h"
+#include "sequence.h"
+#include "live.h"
+#include "filter.h"
+#include "mixer.h"
+#include "cache.h"
 #include "mtxlib.h"
 #include "trackball.h"
 #include "pca.h"
@@ -20,9 +31,24 @@
 using namespace std;
 
 _GLMmodel *mesh;
+BVHtree *bvh;
+BSbasis *basis;
+GLMindexed *indexed;
+GLMbuffers *buffers;
+MTshader *morph;
+MTcrowd *crowd;
+unsigned int crowd_heads = 0;	// heads drawn instead of the single one
+vector<GLfloat> crowd_transforms, crowd_weights;
+GLfloat weights[4];
+bool gpu_morph = false;
+bool wireframe = false;		// overlaid by the shader in the same pass
+bool mesh_stale = false;	// mesh behind the displayed frame
+bool bvh_stale = false;		// bvh behind the mesh, refit when something is picked
 int WindWidth, WindHeight;
 
+TBtrackball trackball;
 int last_x, last_y;
+bool scrubbing = false;		// middle button held over the timeline
 
 const float epsilon = 1e-6;
 
@@ -153,6 +179,8 @@ static bool LoadWAVFile(const char* filename, ALenum* format, ALvoid** data, ALs
 	return true;
 }
 ALuint audio_source = 0;
+ALsizei audio_frequency = 0;	// samples per second of the voice
+ALint audio_samples = 0;	// length of the voice in samples
 void audio_init() {
 
 	//
@@ -206,6 +234,11 @@ void audio_init() {
 
 	// copy the wav into AL buffer 0
 	alBufferData( buffer, format, data, size, freq );
+	audio_frequency = freq;
+	ALint bits, channels;
+	alGetBufferi( buffer, AL_BITS, &bits );
+	alGetBufferi( buffer, AL_CHANNELS, &channels );
+	audio_samples = size / (bits / 8 * channels);
 	free(data);
 	error = alGetError();
 	if ( error != AL_NO_ERROR )
@@ -258,7 +291,7 @@ void Reshape(int width, int height)
 {
 	int base = min(width, height);
 
-	tbReshape(width, height);
+	tbReshape(&trackball, width, height);
 	glViewport(0, 0, width, height);
 	glMatrixMode(GL_PROJECTION);
 	glLoadIdentity();
@@ -271,43 +304,51 @@ void Reshape(int width, int height)
 	WindHeight = height;
 }
 
-void Display(void)
+void DrawScene(void)
 {
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	glPushMatrix();
-	tbMatrix();
+	tbMatrix(&trackball);
 
 	// render solid model
 	glEnable(GL_LIGHTING);
 	glColor3f(1.0, 1.0, 1.0f);
 	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-	glmDraw(mesh, GLM_SMOOTH);
-
-	// render wire model
-	/*glPolygonOffset(1.0, 1.0);
-	glEnable(GL_POLYGON_OFFSET_FILL);
-	glLineWidth(1.0f);
-	glColor3f(0.6, 0.0, 0.8);
-	glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-	glmDraw(mesh, GLM_SMOOTH);
-	*/
+	if (morph)
+		morph->linewidth = wireframe ? 1.0 : 0.0;
+	if (crowd_heads > 0)
+		mtCrowdDraw(crowd, crowd_heads, &crowd_transforms[0], &crowd_weights[0]);
+	else if (gpu_morph || wireframe)
+		mtDraw(morph, weights);
+	else
+		glmDrawBuffers(buffers);
 
 	glPopMatrix();
-
-	glFlush();
-	glutSwapBuffers();
 }
 
-vector3 Unprojection(vector2 _2Dpos)
+void DeformMesh();
+void Scrub(int x, bool start);
+
+// cast a ray through the window position into the mesh; the matrices
+// are plain state queries, so unlike reading back the depth buffer this
+// does not wait for the frame being rendered
+bool Pick(vector2 _2Dpos, BVHhit *hit, vector3 *far_pos)
 {
-	float Depth;
 	int viewport[4];
 	double ModelViewMatrix[16];				//Model_view matrix
 	double ProjectionMatrix[16];			//Projection matrix
 
+	if (mesh_stale)
+		DeformMesh();
+	if (bvh_stale)
+	{
+		bvhRefit(bvh, mesh);
+		bvh_stale = false;
+	}
+
 	glPushMatrix();
-	tbMatrix();
+	tbMatrix(&trackball);
 
 	glGetIntegerv(GL_VIEWPORT, viewport);
 	glGetDoublev(GL_MODELVIEW_MATRIX, ModelViewMatrix);
@@ -315,21 +356,45 @@ vector3 Unprojection(vector2 _2Dpos)
 
 	glPopMatrix();
 
-	glReadPixels((int)_2Dpos.x, viewport[3] - (int)_2Dpos.y, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &Depth);
-
 	double X = _2Dpos.x;
 	double Y = _2Dpos.y;
-	double wpos[3] = { 0.0 , 0.0 , 0.0 };
+	double npos[3] = { 0.0 , 0.0 , 0.0 };
+	double fpos[3] = { 0.0 , 0.0 , 0.0 };
+
+	gluUnProject(X, ((double)viewport[3] - Y), 0.0, ModelViewMatrix, ProjectionMatrix, viewport, &npos[0], &npos[1], &npos[2]);
+	gluUnProject(X, ((double)viewport[3] - Y), 1.0, ModelViewMatrix, ProjectionMatrix, viewport, &fpos[0], &fpos[1], &fpos[2]);
+
+	if (far_pos)
+		*far_pos = vector3(fpos[0], fpos[1], fpos[2]);
+
+	GLfloat origin[3] = { (GLfloat)npos[0], (GLfloat)npos[1], (GLfloat)npos[2] };
+	GLfloat dir[3] = { (GLfloat)(fpos[0] - npos[0]), (GLfloat)(fpos[1] - npos[1]), (GLfloat)(fpos[2] - npos[2]) };
+
+	return bvhIntersect(bvh, mesh, origin, dir, hit);
+}
 
-	gluUnProject(X, ((double)viewport[3] - Y), (double)Depth, ModelViewMatrix, ProjectionMatrix, viewport, &wpos[0], &wpos[1], &wpos[2]);
+vector3 Unprojection(vector2 _2Dpos)
+{
+	BVHhit hit;
+	vector3 far_pos;
 
-	return vector3(wpos[0], wpos[1], wpos[2]);
+	if (Pick(_2Dpos, &hit, &far_pos))
+		return vector3(hit.position[0], hit.position[1], hit.position[2]);
+
+	// nothing under the cursor: same as an empty depth buffer
+	return far_pos;
 }
 
 void mouse(int button, int state, int x, int y)
 {
-	tbMouse(button, state, x, y);
+	tbMouse(&trackball, button, state, x, y);
 
+	if (button == GLUT_MIDDLE_BUTTON)
+	{
+		scrubbing = state == GLUT_DOWN;
+		if (scrubbing)
+			Scrub(x, true);
+	}
 
 	last_x = x;
 	last_y = y;
@@ -337,40 +402,149 @@ void mouse(int button, int state, int x, int y)
 
 void motion(int x, int y)
 {
-	tbMotion(x, y);
+	tbMotion(&trackball, x, y);
+	if (scrubbing)
+		Scrub(x, false);
 	last_x = x;
 	last_y = y;
 }
 
-vector<vector<float> > source;
-vector<float> source_sequece;
+SQtracks *tracks;
+LVstream *live = NULL;	// frames pushed by a producer, played instead of the tracks
+MXmixer *mixer;
+MXlayer *speech, *idle;	// layers of the mixer: the tracks, and sway while idle
+bool idle_motion = false;
+double mix_time = 0;	// Clock() the layers were last mixed at
+double Clock();
 int all = 0;
-float pca_ref1 = 10.0;
-float pca_ref2 = 10.0;
-float pca_ref3 = 10.0;
-float pca_ref4 = 10.0;
+double position = 0;	// frames into the clip, between samples too
 float ref1 = 5;
 float ref2 = 5;
 float ref3 = 14;
 float ref4 = 5;
 bool animate = true;
 
+bool validate_normals = false;
+
+// deformed frames kept for seeking and scrubbing on the CPU path;
+// cache_key is the frame being deformed while one is sought, -1
+// during playback, whose times never repeat
+#define CACHE_FRAMES 64
+FCcache *mesh_cache;
+int cache_key = -1;
+
+// deform the whole mesh on the CPU
+void DeformMesh()
+{
+	bsBlend(basis, weights, &mesh->vertices[3]);
+	bsBlendNormals(basis, weights, mesh);
+	glmIndexedUpdate(indexed, mesh);
+	glmBuffersUpdate(buffers, indexed);
+	mesh_stale = false;
+	bvh_stale = true;
+
+	if (validate_normals)
+	{
+		GLfloat maxerr, meanerr;
+		bsNormalError(basis, mesh, &maxerr, &meanerr);
+		printf("frame %d normal error: max %f mean %f degrees\n", all, maxerr, meanerr);
+	}
+}
+
 void test()
 {
-	for (int i = 1; i <= mesh->numvertices; i++)
+	// the shader skips the full CPU deformation; the mesh and the BVH
+	// used for picking catch up when something is picked
+	if (gpu_morph)
 	{
-		for (int j = 0; j < 3; j++)
-		{
-			mesh->vertices[3 * i + j] = (mean_shape[3 * (i - 1) + j] / 30
-										+ ref1 * pca_ref1 * pca_str1[3 * (i - 1) + j] / 30
-										+ ref2 * pca_ref2 * pca_str2[3 * (i - 1) + j] / 30
-										+ ref3 * pca_ref3 * pca_str3[3 * (i - 1) + j] / 30
-										+ (-1)*ref4 * pca_ref4 * pca_str4[3 * (i - 1) + j] / 30);
-		}
+		mesh_stale = true;
+		return;
+	}
+
+	// a cached frame skips the blend, but leaves the mesh and the BVH
+	// behind like the shader
+	GLfloat *frame = cache_key >= 0 ? fcLookup(mesh_cache, cache_key, weights) : NULL;
+	int size = 3 * indexed->numvertices;
+	if (frame)
+	{
+		copy(frame, frame + size, indexed->vertices);
+		copy(frame + size, frame + 2 * size, indexed->normals);
+		glmBuffersUpdate(buffers, indexed);
+		mesh_stale = true;
+		return;
+	}
+
+	DeformMesh();
+	if (cache_key >= 0)
+	{
+		frame = fcInsert(mesh_cache, cache_key, weights);
+		copy(indexed->vertices, indexed->vertices + size, frame);
+		copy(indexed->normals, indexed->normals + size, frame + size);
 	}
-	glmUnitize(mesh);
 }
 
+// each head of the crowd speaks a different point of the clip
+void CrowdWeights()
+{
+	double start = speech->start;
+	for (unsigned int i = 0; i < crowd_heads; i++)
+	{
+		double frame = fmod(position + (double)i * tracks->numframes / crowd_heads,
+			tracks->numframes);
+		speech->start = mix_time - frame * tracks->frametime;
+		fill(&crowd_weights[4 * i], &crowd_weights[4 * i + 4], 0.0f);
+		mxMix(mixer, mix_time, &crowd_weights[4 * i]);
+	}
+	speech->start = start;
+}
+
+void CrowdSize(unsigned int heads)
+{
+	crowd_heads = heads;
+	crowd_transforms.resize(16 * heads);
+	crowd_weights.resize(4 * heads);
+	if (heads > 0)
+	{
+		mtCrowdGrid(heads, &crowd_transforms[0]);
+		CrowdWeights();
+	}
+	else
+		test();
+}
+
+// render the current weights through both paths and compare the pixels
+void VerifyMorph()
+{
+	int size = WindWidth * WindHeight * 3;
+	vector<unsigned char> cpu(size), gpu(size);
+	bool saved = gpu_morph, saved_wireframe = wireframe;
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	gpu_morph = false;
+	wireframe = false;
+	test();
+	DrawScene();
+	glReadPixels(0, 0, WindWidth, WindHeight, GL_RGB, GL_UNSIGNED_BYTE, &cpu[0]);
+
+	gpu_morph = true;
+	DrawScene();
+	glReadPixels(0, 0, WindWidth, WindHeight, GL_RGB, GL_UNSIGNED_BYTE, &gpu[0]);
+	gpu_morph = saved;
+	wireframe = saved_wireframe;
+
+	int differ = 0, maxdiff = 0;
+	for (int i = 0; i < size; i++)
+	{
+		int d = abs((int)cpu[i] - (int)gpu[i]);
+		if (d > 0)
+			differ++;
+		maxdiff = max(maxdiff, d);
+	}
+	printf("frame %d shader morph: %d of %d channels differ, max difference %d\n", all, differ, size, maxdiff);
+}
+
+void Pause(bool pause);
+
 void Keyboard(unsigned char key, int x, int y) {
 	switch(key) {
 	case 27: // ESC
@@ -380,83 +554,342 @@ void Keyboard(unsigned char key, int x, int y) {
 		alSourcePlay( audio_source );
 		break;
 	case 'z':
-		all = 0;
-		animate = !animate;
+		Pause(animate);
+		break;
+	case 'n':
+		validate_normals = !validate_normals;
+		break;
+	case 'g':
+		if (morph)
+			gpu_morph = !gpu_morph;
+		test();
+		break;
+	case 'v':
+		if (morph)
+			VerifyMorph();
+		break;
+	case 'w':
+		if (morph)
+			wireframe = !wireframe;
+		break;
+	case 'm':
+		if (crowd)
+			CrowdSize(crowd_heads > 0 ? 0 : 25);
+		break;
+	case 'i':
+		idle_motion = !idle_motion;
+		mxFade(idle, Clock(), idle_motion ? 1 : 0, 500);
 		break;
 	}
+	glutPostRedisplay();
 }
 
 
-int timeline = 100000;
-void timf(int value)
+#define RESTART_GAP 110	// ms between the end of the clip and its restart
+#define AV_SNAP 100		// ms of A/V offset the timeline jumps over instead of slewing
+#define AV_SLEW 0.1		// part of the A/V offset corrected per frame
+
+double timeline = 100000;	// ms
+double timeline_clock = 0;	// Clock() the timeline was last advanced to
+double fixed_step = 0;		// ms per frame with -d, 0 to follow the wall clock
+double fixed_clock = 0;		// Clock() with -d: fixed_step per frame produced
+int shown_frame = -1;		// frame the title was last set for
+bool timer_armed = false;
+
+bool voice_waiting = false;	// sought before SQ_AUDIOSTART, the voice starts there
+
+// A/V offset (animation ahead of the voice) over the current play
+double av_offset_sum = 0, av_offset_max = 0;
+int av_offset_count = 0;
+
+// monotonic milliseconds; with -d, the frames produced so far times
+// fixed_step instead, so every frame is the same on every run however
+// long the frames take
+double Clock()
 {
-	int cur = glutGet(GLUT_ELAPSED_TIME);
-	int elapsed = cur - value;
-	timeline += elapsed;
-	glutPostRedisplay();
-	int time_window = 40/4;
-	glutTimerFunc(time_window, timf, cur);
-	if (animate) {
-		all = timeline / time_window;
-		if (all < source[0].size()) {
-			pca_ref1 = source[source_sequece[0]][all];
-			pca_ref2 = source[source_sequece[1]][all];
-			pca_ref3 = source[source_sequece[2]][all];
-			pca_ref4 = source[source_sequece[3]][all];
+	if (fixed_step > 0)
+		return fixed_clock;
+	return chrono::duration<double, milli>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// the point of the timeline the voice is at, or -1 if it isn't playing;
+// the voice starts SQ_AUDIOSTART ms into the tracks
+double AudioTimeline()
+{
+	ALint state, offset;
+
+	if (audio_source == 0)
+		return -1;
+	alGetSourcei(audio_source, AL_SOURCE_STATE, &state);
+	if (state != AL_PLAYING || audio_frequency == 0)
+		return -1;
+	alGetSourcei(audio_source, AL_SAMPLE_OFFSET, &offset);
+	return SQ_AUDIOSTART + offset * 1000.0 / audio_frequency;
+}
+
+void Evaluate(double now);
+
+// put the voice where the timeline is and play it, or hold it until
+// the timeline reaches its start
+void SeekVoice()
+{
+	if (audio_source == 0)
+		return;
+	double offset = (timeline - SQ_AUDIOSTART) * audio_frequency / 1000;
+	voice_waiting = offset < 0;
+	if (voice_waiting)
+		alSourceRewind( audio_source );
+	else if (offset >= audio_samples)
+		alSourceStop( audio_source );
+	else
+	{
+		alSourcei( audio_source, AL_SAMPLE_OFFSET, (ALint)offset );
+		alSourcePlay( audio_source );
+	}
+}
+
+void LogAVOffset()
+{
+	if (av_offset_count > 0)
+		printf("a/v offset: mean %.1f ms, max %.1f ms over %d frames\n",
+			av_offset_sum / av_offset_count, av_offset_max, av_offset_count);
+	av_offset_sum = av_offset_max = 0;
+	av_offset_count = 0;
+}
+
+// live latency (arrival of a frame to its use) since the last report
+double live_latency_sum = 0, live_latency_max = 0;
+int live_latency_count = 0;
+double live_log_clock = 0;
+
+void LogLive()
+{
+	if (live_latency_count > 0)
+		printf("live: latency mean %.1f ms, max %.1f ms, %u frames dropped\n",
+			live_latency_sum / live_latency_count, live_latency_max, live->dropped);
+	live_latency_sum = live_latency_max = 0;
+	live_latency_count = 0;
+}
+
+// evaluate the live frames; the display redraws every refresh, so a
+// frame is on screen at most one refresh after it arrives.  Returns
+// false once the source has ended
+bool AdvanceLive()
+{
+	GLfloat gains[4] = { ref1, ref2, ref3, (-1)*ref4 };
+	if (lvWeights(live, tracks, gains, weights)) {
+		// the other layers go on top of the live speech
+		mix_time = Clock();
+		mxMix(mixer, mix_time, weights);
+		live_latency_sum += live->latency;
+		live_latency_max = max(live_latency_max, live->latency);
+		live_latency_count++;
+		for (unsigned int i = 0; i < crowd_heads; i++)
+			copy(weights, weights + 4, &crowd_weights[4 * i]);
+		if (crowd_heads == 0)
 			test();
-			glutSetWindowTitle((to_string(all) + "_f1=" + to_string(ref1) + "_f2=" + to_string(ref2) + "_f3=" + to_string(ref3) + "_f4=" + to_string(ref4)).c_str());
-		} else if (timeline / time_window > source[0].size() + time_window) {
-			// to fix
-			// use openAL to align audio with video
-			alSourcePlay( audio_source );
-			timeline = 360; // offset
-		}
 	}
+
+	double now = Clock();
+	if (now - live_log_clock >= 1000) {
+		LogLive();
+		live_log_clock = now;
+	}
+	if (lvClosed(live)) {
+		LogLive();
+		puts("live: source ended");
+		return false;
+	}
+	return true;
 }
 
-void readFile() {
-	//read sequence
-	FILE *in_seq;
-	float f1;
-	char str[20];
-	char buffer[10], numbuf[10];
-	for (int i = 0; i < 16; i++)
-	{
-		vector<float> temp_vec;
-		sprintf(numbuf, "%d", i);
-		strcpy(str, "sequence");
-		strcat(str, numbuf);
-		in_seq = fopen(str, "r");
-		if (in_seq == NULL)
-		{
-			perror("Error opening file");
-		}
-		while (!feof(in_seq))
-		{
-			fscanf(in_seq, "%f\n",&f1);
-			temp_vec.push_back(f1);
-		}
-		source.push_back(temp_vec);
-		fclose(in_seq);
+// advance the timeline to the clock and evaluate the tracks there;
+// returns false while the clip is over and waiting to restart
+bool Advance()
+{
+	if (live)
+		return AdvanceLive();
+
+	double now = Clock();
+	timeline += now - timeline_clock;
+	timeline_clock = now;
+
+	// the voice is the master clock while it plays.  OpenAL moves the
+	// sample offset in mixer sized steps, so the smooth clock above is
+	// slewed towards it rather than set, unless it is far off (the
+	// voice was restarted, or a frame took very long)
+	double audio = AudioTimeline();
+	if (audio >= 0) {
+		double offset = timeline - audio;
+		av_offset_sum += offset;
+		av_offset_max = max(av_offset_max, fabs(offset));
+		av_offset_count++;
+		if (fabs(offset) > AV_SNAP)
+			timeline = audio;
+		else
+			timeline -= offset * AV_SLEW;
+	}
+
+	double length = tracks->numframes * tracks->frametime;
+	if (timeline >= length + RESTART_GAP) {
+		LogAVOffset();
+		timeline = SQ_AUDIOSTART;
+		SeekVoice();
+	}
+	if (voice_waiting && timeline >= SQ_AUDIOSTART)
+		SeekVoice();
+	if (timeline >= length)
+		return false;
+
+	Evaluate(now);
+	return true;
+}
+
+// evaluate the tracks at the timeline, mixed at a clock time
+void Evaluate(double now)
+{
+	position = timeline / tracks->frametime;
+	all = (int)position;
+	mix_time = now;
+	speech->start = now - timeline;
+	fill(weights, weights + 4, 0.0f);
+	mxMix(mixer, mix_time, weights);
+	if (crowd_heads > 0)
+		CrowdWeights();
+	else
+		test();
+	if (all != shown_frame) {
+		shown_frame = all;
+		char title[128];
+		snprintf(title, sizeof(title), "%d_f1=%f_f2=%f_f3=%f_f4=%f", all, ref1, ref2, ref3, ref4);
+		glutSetWindowTitle(title);
 	}
+}
 
-	int d1;
-	in_seq = fopen("correspond_sequence", "r");
-	if (in_seq == NULL)
+// pause or resume the animation, and the voice with it
+void Pause(bool pause)
+{
+	if (pause != animate)
+		return;
+	animate = !pause;
+	if (live)
+		return;
+	if (pause)
 	{
-		perror("Error opening file");
+		ALint state;
+		if (audio_source == 0)
+			return;
+		alGetSourcei(audio_source, AL_SOURCE_STATE, &state);
+		if (state == AL_PLAYING)
+			alSourcePause( audio_source );
+		return;
 	}
-	while (!feof(in_seq))
+
+	// play on from wherever the timeline was sought to
+	timeline_clock = Clock();
+	SeekVoice();
+	if (mesh_cache->hits + mesh_cache->misses > 0)
+		printf("frame cache: %u hits, %u misses\n", mesh_cache->hits, mesh_cache->misses);
+	mesh_cache->hits = mesh_cache->misses = 0;
+}
+
+// pause on the frame nearest a point of the timeline; the deformation
+// of the frame is cached, so going back and forth over a phrase only
+// blends each frame once
+void Seek(double to)
+{
+	if (live)
+		return;
+	Pause(true);
+
+	double last = (tracks->numframes - 1) * tracks->frametime;
+	int frame = (int)floor(min(max(to, 0.0), last) / tracks->frametime + 0.5);
+	timeline = frame * tracks->frametime;
+	cache_key = frame;
+	Evaluate(Clock());
+	cache_key = -1;
+	glutPostRedisplay();
+}
+
+// drag with the middle button to scrub, a frame per pixel
+int scrub_x;			// x the drag started at
+double scrub_from;		// timeline when the drag started
+
+void Scrub(int x, bool start)
+{
+	if (start)
 	{
-		fscanf(in_seq, "%d\n", &d1);
-		source_sequece.push_back(d1);
+		scrub_x = x;
+		scrub_from = timeline;
 	}
-	fclose(in_seq);
+	Seek(scrub_from + (x - scrub_x) * tracks->frametime);
+}
+
+// arrows step a frame (ten with shift), home and end seek to the ends
+void Special(int key, int x, int y)
+{
+	double step = (glutGetModifiers() & GLUT_ACTIVE_SHIFT) ? 10 : 1;
+	switch(key) {
+	case GLUT_KEY_LEFT:
+		Seek(timeline - step * tracks->frametime);
+		break;
+	case GLUT_KEY_RIGHT:
+		Seek(timeline + step * tracks->frametime);
+		break;
+	case GLUT_KEY_HOME:
+		Seek(0);
+		break;
+	case GLUT_KEY_END:
+		Seek(tracks->numframes * tracks->frametime);
+		break;
+	}
+}
+
+void timf(int value)
+{
+	timer_armed = false;
+	if (animate)
+		glutPostRedisplay();
+}
+
+// sleep through the gap before the clip restarts
+void Schedule()
+{
+	if (timer_armed || live)
+		return;
+	double wait = tracks->numframes * tracks->frametime + RESTART_GAP - timeline;
+	glutTimerFunc(wait > 0 ? (unsigned int)ceil(wait) : 0, timf, 0);
+	timer_armed = true;
+}
+
+void Display(void)
+{
+	if (animate && fixed_step > 0)
+		fixed_clock += fixed_step;
+	bool playing = animate && Advance();
+
+	DrawScene();
+
+	glFlush();
+	glutSwapBuffers();
+
+	// while the clip plays the next frame is drawn as soon as this one
+	// is swapped, paced by the display refresh.  A fixed step draws the
+	// gap before the restart too, rather than wait for it
+	if (playing || (animate && fixed_step > 0))
+		glutPostRedisplay();
+	else if (animate)
+		Schedule();
 }
 
 int main(int argc, char *argv[])
 {
-	readFile();
+	tracks = sqRead(".");
+	if (!tracks || tracks->numselected < 4)
+	{
+		fputs("Couldn't read the weight sequences\n", stderr);
+		exit(1);
+	}
 	WindWidth = 1024;
 	WindHeight = 768;
 
@@ -472,11 +905,48 @@ int main(int argc, char *argv[])
 	glutInitDisplayMode(GLUT_RGB | GLUT_DEPTH | GLUT_DOUBLE);
 	glutCreateWindow("Display Animation");
 
+	// -l source plays weight frames pushed by a producer (see live.h)
+	// instead of the tracks, -j ms behind their arrival; -F smooths the
+	// raw predictions of both (see flParse(), "none" for no filter).
+	// -d fps advances the timeline 1/fps per frame drawn, as fast as
+	// they can be drawn, without the voice
+	const char *live_source = NULL, *filter_spec = "flat";
+	double live_jitter = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-l") && i + 1 < argc)
+			live_source = argv[++i];
+		else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+			live_jitter = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-F") && i + 1 < argc)
+			filter_spec = argv[++i];
+		else if (!strcmp(argv[i], "-d") && i + 1 < argc && atof(argv[i + 1]) > 0)
+			fixed_step = 1000 / atof(argv[++i]);
+		else
+		{
+			fprintf(stderr, "usage: %s [-l source [-j jitter] | -d fps] [-F filter]\n", argv[0]);
+			exit(1);
+		}
+	}
+	if (!sqFilter(tracks, filter_spec))
+		exit(1);
+	if (live_source && fixed_step > 0)
+	{
+		fputs("-d can't step the frames of a live source\n", stderr);
+		exit(1);
+	}
+
+	// one frame per refresh while the clip plays, instead of as many as
+	// the driver can render (unless the frames are on a fixed step)
+	GLint swap_interval = fixed_step > 0 ? 0 : 1;
+	CGLSetParameter(CGLGetCurrentContext(), kCGLCPSwapInterval, &swap_interval);
+
 	glutReshapeFunc(Reshape);
 	glutDisplayFunc(Display);
 	glutMouseFunc(mouse);
 	glutMotionFunc(motion);
 	glutKeyboardFunc(Keyboard);
+	glutSpecialFunc(Special);
 	glClearColor(0, 0, 0, 0);
 
 	glLightfv(GL_LIGHT0, GL_AMBIENT, light_ambient);
@@ -490,10 +960,10 @@ int main(int argc, char *argv[])
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_LIGHTING);
 	glEnable(GL_COLOR_MATERIAL);
-	tbInit(GLUT_LEFT_BUTTON);
-	tbAnimate(GL_FALSE);
+	tbInit(&trackball, GLUT_LEFT_BUTTON);
+	tbAnimate(&trackball, GL_FALSE);
 
-	glutTimerFunc(0, timf, 0); // Set up timer for 40ms, about 25 fps
+	timeline_clock = Clock();
 
 	// load 3D model
 	std::cout << "Loading model ... ";
@@ -503,8 +973,50 @@ int main(int argc, char *argv[])
 	glmUnitize(mesh);
 	glmFacetNormals(mesh);
 	glmVertexNormals(mesh, 90.0);
-
-	audio_init();
+	bvh = bvhBuild(mesh);
+
+	basis = bsCreate(mesh->numvertices, mean_shape, 1.0 / 30);
+	bsAddComponent(basis, pca_str1);
+	bsAddComponent(basis, pca_str2);
+	bsAddComponent(basis, pca_str3);
+	bsAddComponent(basis, pca_str4);
+	bsUnitize(basis);
+	bsNormalBasis(basis, mesh);
+	indexed = glmIndexed(mesh, GLM_SMOOTH);
+	buffers = glmBuffers(indexed);
+	morph = mtCreate(basis, indexed);
+	crowd = morph ? mtCrowdCreate(morph) : NULL;
+
+	// the speech, and a slow sway of the face faded in with 'i'
+	GLfloat gains[4] = { ref1, ref2, ref3, (-1)*ref4 };
+	GLfloat sway_amplitudes[4] = { 0.3, 0.2, 0.4, 0.2 };
+	GLfloat sway_periods[4] = { 4100, 3300, 5700, 2900 };
+	GLfloat sway_phases[4] = { 0, 0.25, 0.5, 0.75 };
+	mixer = mxCreate(4);
+	speech = mxAddTracks(mixer, tracks, gains, MX_ADD);
+	idle = mxAddSine(mixer, sway_amplitudes, sway_periods, sway_phases, MX_ADD);
+	mxFade(idle, 0, 0, 0);
+
+	mesh_cache = fcCreate(CACHE_FRAMES, 6 * indexed->numvertices, 4);
+
+	if (live_source)
+	{
+		FLfilter *filter = NULL;
+		if (strcmp(filter_spec, "none"))
+		{
+			filter = flParse(filter_spec, tracks->numtracks,
+				SQ_MODELTIME / SQ_FRAMETIME, SQ_FRAMETIME);
+			if (!filter)
+				exit(1);
+		}
+		live = lvOpen(live_source, tracks->numtracks, live_jitter, filter);
+		if (!live)
+			exit(1);
+		mxFade(speech, 0, 0, 0);
+		live_log_clock = Clock();
+	}
+	else if (fixed_step == 0)
+		audio_init();
 	glutMainLoop();
 
 	return 0;
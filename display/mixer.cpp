@@ -0,0 +1,279 @@
+/*
+      mixer.cpp
+
+      Layered mixing of basis weights.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "mixer.h"
+
+
+/* mxAdd: add a layer at full weight with an open mask */
+static MXlayer*
+mxAdd(MXmixer* mixer, GLuint source, GLuint mode)
+{
+    MXlayer* layer;
+    GLuint k;
+
+    assert(mixer);
+    assert(mixer->numlayers < MX_MAX_LAYERS);
+    assert(mode == MX_ADD || mode == MX_OVERRIDE);
+
+    layer = (MXlayer*)malloc(sizeof(MXlayer));
+    memset(layer, 0, sizeof(MXlayer));
+    layer->source = source;
+    layer->mode = mode;
+    layer->mask = (GLfloat*)malloc(sizeof(GLfloat) * mixer->numcomponents);
+    for (k = 0; k < mixer->numcomponents; k++)
+        layer->mask[k] = 1.0f;
+    layer->start = 0.0;
+    layer->from = layer->to = 1.0f;
+    layer->fadestart = 0.0;
+    layer->fadetime = 0.0;
+
+    mixer->layers[mixer->numlayers++] = layer;
+    return layer;
+}
+
+/* mxCopy: a malloc'd copy of numcomponents values */
+static GLfloat*
+mxCopy(MXmixer* mixer, GLfloat* values)
+{
+    GLfloat* copy;
+
+    assert(values);
+
+    copy = (GLfloat*)malloc(sizeof(GLfloat) * mixer->numcomponents);
+    memcpy(copy, values, sizeof(GLfloat) * mixer->numcomponents);
+    return copy;
+}
+
+/* mxValues: the values of a layer at its own time */
+static GLvoid
+mxValues(MXmixer* mixer, MXlayer* layer, GLdouble time, GLfloat* values)
+{
+    GLdouble frame;
+    GLuint k;
+
+    if (layer->source == MX_TRACKS) {
+        frame = time / layer->tracks->frametime;
+        if (layer->loop) {
+            frame = fmod(frame, layer->tracks->numframes);
+            if (frame < 0.0)
+                frame += layer->tracks->numframes;
+        }
+        sqWeightsAt(layer->tracks, frame, layer->gains, values);
+    } else {
+        for (k = 0; k < mixer->numcomponents; k++)
+            values[k] = layer->amplitudes[k] * (GLfloat)sin(2.0 * M_PI *
+                (time / layer->periods[k] + layer->phases[k]));
+    }
+}
+
+
+/* public functions */
+
+
+/* mxCreate: Creates a mixer with no layers.
+ *
+ * numcomponents - number of basis weights
+ */
+MXmixer*
+mxCreate(GLuint numcomponents)
+{
+    MXmixer* mixer;
+
+    assert(numcomponents > 0);
+
+    mixer = (MXmixer*)malloc(sizeof(MXmixer));
+    mixer->numcomponents = numcomponents;
+    mixer->numlayers = 0;
+    mixer->values = (GLfloat*)malloc(sizeof(GLfloat) * numcomponents);
+
+    return mixer;
+}
+
+/* mxAddTracks: Adds a layer playing weight tracks, at full weight.
+ *
+ * mixer  - structure created with mxCreate()
+ * tracks - tracks with numcomponents entries in correspond_sequence
+ * gains  - array of numcomponents GLfloats
+ * mode   - MX_ADD or MX_OVERRIDE
+ */
+MXlayer*
+mxAddTracks(MXmixer* mixer, SQtracks* tracks, GLfloat* gains, GLuint mode)
+{
+    MXlayer* layer;
+
+    assert(tracks);
+    assert(tracks->numselected == mixer->numcomponents);
+    assert(tracks->numframes > 0);
+
+    layer = mxAdd(mixer, MX_TRACKS, mode);
+    layer->tracks = tracks;
+    layer->gains = mxCopy(mixer, gains);
+    layer->loop = GL_FALSE;
+
+    return layer;
+}
+
+/* mxAddSine: Adds a layer of sines, at full weight.
+ *
+ * mixer      - structure created with mxCreate()
+ * amplitudes - array of numcomponents GLfloats
+ * periods    - array of numcomponents GLfloats, ms
+ * phases     - array of numcomponents GLfloats, periods
+ * mode       - MX_ADD or MX_OVERRIDE
+ */
+MXlayer*
+mxAddSine(MXmixer* mixer, GLfloat* amplitudes, GLfloat* periods, GLfloat* phases,
+          GLuint mode)
+{
+    MXlayer* layer;
+    GLuint k;
+
+    for (k = 0; k < mixer->numcomponents; k++)
+        assert(periods[k] > 0.0f);
+
+    layer = mxAdd(mixer, MX_SINE, mode);
+    layer->amplitudes = mxCopy(mixer, amplitudes);
+    layer->periods = mxCopy(mixer, periods);
+    layer->phases = mxCopy(mixer, phases);
+
+    return layer;
+}
+
+/* mxFade: Fades the weight of a layer from its current value.
+ *
+ * layer    - layer of a mixer
+ * time     - time the fade starts
+ * weight   - weight to fade to
+ * duration - length of the fade, ms (0 to jump)
+ */
+GLvoid
+mxFade(MXlayer* layer, GLdouble time, GLfloat weight, GLdouble duration)
+{
+    assert(layer);
+
+    layer->from = mxWeight(layer, time);
+    layer->to = weight;
+    layer->fadestart = time;
+    layer->fadetime = duration;
+}
+
+/* mxWeight: Returns the weight of a layer at a time.
+ *
+ * layer - layer of a mixer
+ * time  - time
+ */
+GLfloat
+mxWeight(MXlayer* layer, GLdouble time)
+{
+    GLfloat s;
+
+    assert(layer);
+
+    if (layer->fadetime <= 0.0 || time >= layer->fadestart + layer->fadetime)
+        return layer->to;
+    if (time <= layer->fadestart)
+        return layer->from;
+    s = (GLfloat)((time - layer->fadestart) / layer->fadetime);
+    return layer->from + (layer->to - layer->from) * s * s * (3.0f - 2.0f * s);
+}
+
+/* mxMix: Mixes the layers at a time onto a set of weights.
+ *
+ * mixer   - structure created with mxCreate()
+ * time    - time
+ * weights - array of numcomponents GLfloats, the base the layers are
+ *           mixed onto (zeros for none), replaced by the mix
+ */
+GLvoid
+mxMix(MXmixer* mixer, GLdouble time, GLfloat* weights)
+{
+    MXlayer* layer;
+    GLfloat weight, m;
+    GLuint i, k;
+
+    assert(mixer);
+    assert(weights);
+
+    for (i = 0; i < mixer->numlayers; i++) {
+        layer = mixer->layers[i];
+        weight = mxWeight(layer, time);
+        if (weight == 0.0f)
+            continue;
+
+        mxValues(mixer, layer, time - layer->start, mixer->values);
+        for (k = 0; k < mixer->numcomponents; k++) {
+            m = weight * layer->mask[k];
+            if (layer->mode == MX_ADD)
+                weights[k] += m * mixer->values[k];
+            else
+                weights[k] += m * (mixer->values[k] - weights[k]);
+        }
+    }
+}
+
+/* mxRange: Finds a bound of the absolute value of each weight the
+ * layers can produce at full weight.
+ *
+ * mixer      - structure created with mxCreate()
+ * maxweights - array of numcomponents GLfloats to write the bounds to
+ */
+GLvoid
+mxRange(MXmixer* mixer, GLfloat* maxweights)
+{
+    MXlayer* layer;
+    GLfloat bound;
+    GLuint i, k;
+
+    assert(mixer);
+    assert(maxweights);
+
+    for (k = 0; k < mixer->numcomponents; k++)
+        maxweights[k] = 0.0f;
+    for (i = 0; i < mixer->numlayers; i++) {
+        layer = mixer->layers[i];
+        if (layer->source == MX_TRACKS)
+            sqRange(layer->tracks, layer->gains, mixer->values);
+        for (k = 0; k < mixer->numcomponents; k++) {
+            bound = layer->source == MX_TRACKS ? mixer->values[k] : fabs(layer->amplitudes[k]);
+            bound *= fabs(layer->mask[k]);
+            /* an override blends between values within both bounds */
+            if (layer->mode == MX_ADD)
+                maxweights[k] += bound;
+            else if (bound > maxweights[k])
+                maxweights[k] = bound;
+        }
+    }
+}
+
+/* mxDelete: Deletes a MXmixer structure and its layers.
+ *
+ * mixer - structure created with mxCreate()
+ */
+GLvoid
+mxDelete(MXmixer* mixer)
+{
+    MXlayer* layer;
+    GLuint i;
+
+    assert(mixer);
+
+    for (i = 0; i < mixer->numlayers; i++) {
+        layer = mixer->layers[i];
+        free(layer->mask);
+        free(layer->gains);
+        free(layer->amplitudes);
+        free(layer->periods);
+        free(layer->phases);
+        free(layer);
+    }
+    free(mixer->values);
+    free(mixer);
+}
@@ -0,0 +1,148 @@
+/*
+      mixer.h
+
+      Layered mixing of basis weights.
+
+      Every source of motion (the speech tracks, idle sway, ...) is a
+      layer that produces one value per basis component.  mxMix()
+      combines the layers, in the order they were added, into the
+      weights of a single blend, so a layer costs a few operations per
+      component and never a pass over the mesh.  A layer either adds
+      its values (MX_ADD) or replaces what the layers below produced
+      (MX_OVERRIDE); either way its effect is scaled per component by
+      its mask and overall by its weight, which fades between values
+      along a smoothstep curve.
+
+      Times are in ms on whatever clock the caller passes to mxMix();
+      a layer's own time runs from its start.
+
+ */
+
+#ifndef MIXER_H
+#define MIXER_H
+
+#include "glm.h"
+#include "sequence.h"
+
+
+#define MX_MAX_LAYERS 8         /* layers per mixer */
+
+#define MX_TRACKS 0             /* source: weight tracks (sequence.h) */
+#define MX_SINE 1               /* source: a sine per component */
+
+#define MX_ADD 0                /* mode: add to the layers below */
+#define MX_OVERRIDE 1           /* mode: replace the layers below */
+
+
+/* MXlayer: Structure that defines a layer.
+ */
+typedef struct _MXlayer {
+  GLuint   source;              /* MX_TRACKS or MX_SINE */
+  GLuint   mode;                /* MX_ADD or MX_OVERRIDE */
+  GLfloat* mask;                /* effect on each component, 1 by default */
+  GLdouble start;               /* time at which the layer's time is 0 */
+
+  SQtracks* tracks;             /* MX_TRACKS: the tracks */
+  GLfloat* gains;               /* MX_TRACKS: gain of each component */
+  GLboolean loop;               /* MX_TRACKS: repeat instead of holding the end */
+
+  GLfloat* amplitudes;          /* MX_SINE: amplitude of each component */
+  GLfloat* periods;             /* MX_SINE: period of each component, ms */
+  GLfloat* phases;              /* MX_SINE: phase of each component, periods */
+
+  GLfloat  from;                /* weight the fade starts at */
+  GLfloat  to;                  /* weight the fade ends at */
+  GLdouble fadestart;           /* time the fade starts */
+  GLdouble fadetime;            /* length of the fade, ms */
+} MXlayer;
+
+/* MXmixer: Structure that defines a stack of layers.
+ */
+typedef struct _MXmixer {
+  GLuint   numcomponents;       /* values per layer */
+  GLuint   numlayers;           /* number of layers */
+  MXlayer* layers[MX_MAX_LAYERS]; /* bottom layer first */
+  GLfloat* values;              /* values of the layer being mixed */
+} MXmixer;
+
+
+/* mxCreate: Creates a mixer with no layers.  Returns a pointer to the
+ * created structure which should be free'd with mxDelete().
+ *
+ * numcomponents - number of basis weights
+ */
+MXmixer*
+mxCreate(GLuint numcomponents);
+
+/* mxAddTracks: Adds a layer playing weight tracks (see sqWeightsAt()),
+ * at full weight.  Returns the layer, owned by the mixer.
+ *
+ * mixer  - structure created with mxCreate()
+ * tracks - tracks with numcomponents entries in correspond_sequence
+ * gains  - array of numcomponents GLfloats
+ * mode   - MX_ADD or MX_OVERRIDE
+ */
+MXlayer*
+mxAddTracks(MXmixer* mixer, SQtracks* tracks, GLfloat* gains, GLuint mode);
+
+/* mxAddSine: Adds a layer of sines,
+ *
+ *     amplitudes[k] * sin(2 pi (time / periods[k] + phases[k]))
+ *
+ * at full weight.  Returns the layer, owned by the mixer.
+ *
+ * mixer      - structure created with mxCreate()
+ * amplitudes - array of numcomponents GLfloats
+ * periods    - array of numcomponents GLfloats, ms
+ * phases     - array of numcomponents GLfloats, periods
+ * mode       - MX_ADD or MX_OVERRIDE
+ */
+MXlayer*
+mxAddSine(MXmixer* mixer, GLfloat* amplitudes, GLfloat* periods, GLfloat* phases,
+          GLuint mode);
+
+/* mxFade: Fades the weight of a layer from its current value.
+ *
+ * layer    - layer of a mixer
+ * time     - time the fade starts
+ * weight   - weight to fade to
+ * duration - length of the fade, ms (0 to jump)
+ */
+GLvoid
+mxFade(MXlayer* layer, GLdouble time, GLfloat weight, GLdouble duration);
+
+/* mxWeight: Returns the weight of a layer at a time.
+ *
+ * layer - layer of a mixer
+ * time  - time
+ */
+GLfloat
+mxWeight(MXlayer* layer, GLdouble time);
+
+/* mxMix: Mixes the layers at a time onto a set of weights.
+ *
+ * mixer   - structure created with mxCreate()
+ * time    - time
+ * weights - array of numcomponents GLfloats, the base the layers are
+ *           mixed onto (zeros for none), replaced by the mix
+ */
+GLvoid
+mxMix(MXmixer* mixer, GLdouble time, GLfloat* weights);
+
+/* mxRange: Finds a bound of the absolute value of each weight the
+ * layers can produce at full weight.
+ *
+ * mixer      - structure created with mxCreate()
+ * maxweights - array of numcomponents GLfloats to write the bounds to
+ */
+GLvoid
+mxRange(MXmixer* mixer, GLfloat* maxweights);
+
+/* mxDelete: Deletes a MXmixer structure and its layers.
+ *
+ * mixer - structure created with mxCreate()
+ */
+GLvoid
+mxDelete(MXmixer* mixer);
+
+#endif
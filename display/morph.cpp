@@ -0,0 +1,573 @@
+/*
+      morph.cpp
+
+      Blendshape evaluation in a vertex shader.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "morph.h"
+
+
+#define MT_CROWD_LOOP      1    /* crowd batch, one draw per instance */
+#define MT_CROWD_INSTANCED 2    /* crowd batch, one instanced draw */
+
+
+/* fixed-function lighting of one directional light with
+   GL_COLOR_MATERIAL driving ambient and diffuse, for the eye space
+   normal n */
+static const char* mtLighting =
+    "    vec3 l = normalize(gl_LightSource[0].position.xyz);\n"
+    "    float d = max(dot(n, l), 0.0);\n"
+    "    vec4 c = gl_LightModel.ambient * gl_Color\n"
+    "           + gl_LightSource[0].ambient * gl_Color\n"
+    "           + d * gl_LightSource[0].diffuse * gl_Color;\n"
+    "    if (d > 0.0)\n"
+    "        c += pow(max(dot(n, normalize(l + vec3(0.0, 0.0, 1.0))), 0.0),\n"
+    "                 gl_FrontMaterial.shininess)\n"
+    "             * gl_LightSource[0].specular * gl_FrontMaterial.specular;\n"
+    "    gl_FrontColor = vec4(c.rgb, gl_Color.a);\n"
+    "    gl_BackColor = gl_FrontColor;\n";
+
+/* the fragment stage of the fixed-function pipeline (no texture, no
+   fog), blended towards the line color within linewidth / 2 pixels
+   of an edge */
+static const char* mtFragmentSource =
+    "#version 120\n"
+    "varying vec3 barycentric;\n"
+    "uniform float linewidth;\n"
+    "uniform vec4 linecolor;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_FragColor = gl_Color;\n"
+    "    if (linewidth > 0.0) {\n"
+    "        vec3 d = barycentric / fwidth(barycentric);\n"
+    "        float e = min(min(d.x, d.y), d.z);\n"
+    "        float a = 1.0 - clamp(e - 0.5 * linewidth + 0.5, 0.0, 1.0);\n"
+    "        gl_FragColor.rgb = mix(gl_Color.rgb, linecolor.rgb, a * linecolor.a);\n"
+    "    }\n"
+    "}\n";
+
+/* mtShaderSource: build the vertex shader for numcomponents components
+ *
+ * crowd  - 0 for one shape, MT_CROWD_INSTANCED for a batch of
+ *          instances drawn with one instanced draw, or any other value
+ *          for a batch drawn one instance at a time
+ * source - buffer of at least 4096 chars
+ */
+static GLvoid
+mtShaderSource(GLuint numcomponents, GLuint crowd, char* source)
+{
+    char line[160];
+    GLuint k;
+
+    strcpy(source, "#version 120\n");
+    if (crowd == MT_CROWD_INSTANCED)
+        strcat(source,
+            "#extension GL_ARB_draw_instanced : require\n"
+            "#define INSTANCE gl_InstanceIDARB\n");
+    else if (crowd)
+        strcat(source,
+            "uniform int instance;\n"
+            "#define INSTANCE instance\n");
+    strcat(source,
+        "attribute vec3 mean;\n"
+        "attribute vec3 meannormal;\n"
+        "attribute float corner;\n"
+        "varying vec3 barycentric;\n");
+    for (k = 0; k < numcomponents; k++) {
+        sprintf(line, "attribute vec3 component%u;\nattribute vec3 normaldelta%u;\n", k, k);
+        strcat(source, line);
+    }
+    if (crowd) {
+        sprintf(line,
+            "uniform float weights[%u];\n"
+            "uniform mat4 transforms[%u];\n", MT_CROWD_BATCH * numcomponents, MT_CROWD_BATCH);
+        strcat(source, line);
+    } else {
+        sprintf(line, "uniform float weights[%u];\n", numcomponents);
+        strcat(source, line);
+    }
+    strcat(source,
+        "uniform float scale;\n"
+        "uniform vec3 center;\n"
+        "void main()\n"
+        "{\n"
+        "    vec3 p = mean;\n"
+        "    vec3 n = meannormal;\n"
+        "    barycentric = vec3(equal(vec3(corner), vec3(0.0, 1.0, 2.0)));\n");
+    if (crowd) {
+        sprintf(line, "    int base = INSTANCE * %u;\n", numcomponents);
+        strcat(source, line);
+    }
+    for (k = 0; k < numcomponents; k++) {
+        if (crowd)
+            sprintf(line,
+                "    p += weights[base + %u] * component%u;\n"
+                "    n += weights[base + %u] * normaldelta%u;\n", k, k, k, k);
+        else
+            sprintf(line,
+                "    p += weights[%u] * component%u;\n"
+                "    n += weights[%u] * normaldelta%u;\n", k, k, k, k);
+        strcat(source, line);
+    }
+    strcat(source, "    p = scale * p - center;\n");
+    if (crowd)
+        strcat(source,
+            "    mat4 t = transforms[INSTANCE];\n"
+            "    n = normalize(gl_NormalMatrix * (mat3(t) * n));\n");
+    else
+        strcat(source, "    n = normalize(gl_NormalMatrix * n);\n");
+    strcat(source, mtLighting);
+    if (crowd)
+        strcat(source, "    gl_Position = gl_ModelViewProjectionMatrix * (t * vec4(p, 1.0));\n");
+    else
+        strcat(source, "    gl_Position = gl_ModelViewProjectionMatrix * vec4(p, 1.0);\n");
+    strcat(source, "}\n");
+}
+
+/* mtLink: compile and link a blending program, binding the attribute
+ * locations mtBindAttributes() uses
+ *
+ * caller - name of the public function, for the error messages
+ * returns the program, or 0 if it fails to compile or link
+ */
+static GLuint
+mtLink(GLuint numcomponents, const char* source, const char* caller)
+{
+    GLuint shaders[2], program, i, k;
+    GLint status;
+    char log[1024];
+    const char* sources[2];
+    char name[32];
+
+    sources[0] = source;
+    sources[1] = mtFragmentSource;
+    program = glCreateProgram();
+    for (i = 0; i < 2; i++) {
+        shaders[i] = glCreateShader(i == 0 ? GL_VERTEX_SHADER : GL_FRAGMENT_SHADER);
+        glShaderSource(shaders[i], 1, &sources[i], NULL);
+        glCompileShader(shaders[i]);
+        glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &status);
+        if (!status) {
+            glGetShaderInfoLog(shaders[i], sizeof(log), NULL, log);
+            fprintf(stderr, "%s() failed: can't compile shader:\n%s\n", caller, log);
+            glDeleteShader(shaders[i]);
+            glDeleteProgram(program);
+            return 0;
+        }
+        glAttachShader(program, shaders[i]);
+        glDeleteShader(shaders[i]);
+    }
+
+    /* attribute 2 * k + 2 is component k, 2 * k + 3 its normal delta,
+       and the corner number comes last */
+    glBindAttribLocation(program, 0, "mean");
+    glBindAttribLocation(program, 1, "meannormal");
+    for (k = 0; k < numcomponents; k++) {
+        sprintf(name, "component%u", k);
+        glBindAttribLocation(program, 2 * k + 2, name);
+        sprintf(name, "normaldelta%u", k);
+        glBindAttribLocation(program, 2 * k + 3, name);
+    }
+    glBindAttribLocation(program, 2 * numcomponents + 2, "corner");
+    glLinkProgram(program);
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (!status) {
+        glGetProgramInfoLog(program, sizeof(log), NULL, log);
+        fprintf(stderr, "%s() failed: can't link shader:\n%s\n", caller, log);
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    return program;
+}
+
+/* mtBindAttributes: enable the attribute arrays and the index buffer */
+static GLvoid
+mtBindAttributes(MTshader* shader)
+{
+    GLuint k, numarrays;
+
+    numarrays = 2 * (shader->basis->numcomponents + 1);
+    glBindBuffer(GL_ARRAY_BUFFER, shader->attributebuffer);
+    for (k = 0; k < numarrays; k++) {
+        glEnableVertexAttribArray(k);
+        glVertexAttribPointer(k, 3, GL_FLOAT, GL_FALSE, 0,
+            (GLvoid*)(sizeof(GLfloat) * 3 * shader->numvertices * k));
+    }
+    glEnableVertexAttribArray(numarrays);
+    glVertexAttribPointer(numarrays, 1, GL_FLOAT, GL_FALSE, 0,
+        (GLvoid*)(sizeof(GLfloat) * 3 * shader->numvertices * numarrays));
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, shader->indexbuffer);
+}
+
+/* mtUnbindAttributes: undo mtBindAttributes() */
+static GLvoid
+mtUnbindAttributes(MTshader* shader)
+{
+    GLuint k, numarrays;
+
+    numarrays = 2 * (shader->basis->numcomponents + 1);
+    for (k = 0; k <= numarrays; k++)
+        glDisableVertexAttribArray(k);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/* mtCorners: number the corners of every triangle 0, 1 and 2, so the
+ * shader can turn the number into barycentric coordinates for the
+ * wireframe.  A vertex has one number in all the triangles that share
+ * it, so a welded vertex whose triangles need different numbers gets
+ * a copy for each (at most three).
+ *
+ * indices - array of numindices GLuints, rewritten to the new vertices
+ * sources - returns a malloc'd array of the welded vertex of each vertex
+ * corners - returns a malloc'd array of the corner number of each vertex
+ * returns the number of vertices, at least indexed->numvertices
+ */
+static GLuint
+mtCorners(GLMindexed* indexed, GLuint* indices, GLuint** sources, GLfloat** corners)
+{
+    GLuint numvertices, size, taken, t, i, j, w, corner;
+    GLuint* copies;
+    GLboolean numbered[3];
+
+    /* copies[3 * w + corner] is the vertex numbered corner of welded
+       vertex w, or -1; the first one numbered reuses w itself */
+    copies = (GLuint*)malloc(sizeof(GLuint) * 3 * indexed->numvertices);
+    for (i = 0; i < 3 * indexed->numvertices; i++)
+        copies[i] = (GLuint)-1;
+    numvertices = indexed->numvertices;
+    size = 2 * numvertices;
+    *sources = (GLuint*)malloc(sizeof(GLuint) * size);
+    *corners = (GLfloat*)malloc(sizeof(GLfloat) * size);
+    for (w = 0; w < indexed->numvertices; w++) {
+        (*sources)[w] = w;
+        (*corners)[w] = 0.0f;
+    }
+
+    for (t = 0; t < indexed->numindices / 3; t++) {
+        /* first the corners with a copy under a free number */
+        taken = 0;
+        for (j = 0; j < 3; j++) {
+            w = indexed->indices[3 * t + j];
+            numbered[j] = GL_FALSE;
+            for (corner = 0; corner < 3; corner++) {
+                if (!(taken & (1 << corner)) && copies[3 * w + corner] != (GLuint)-1) {
+                    indices[3 * t + j] = copies[3 * w + corner];
+                    taken |= 1 << corner;
+                    numbered[j] = GL_TRUE;
+                    break;
+                }
+            }
+        }
+        /* then a new copy under the lowest free number */
+        for (j = 0; j < 3; j++) {
+            if (numbered[j])
+                continue;
+            for (corner = 0; taken & (1 << corner); corner++)
+                ;
+            taken |= 1 << corner;
+            w = indexed->indices[3 * t + j];
+            if (copies[3 * w] == (GLuint)-1 && copies[3 * w + 1] == (GLuint)-1 &&
+                copies[3 * w + 2] == (GLuint)-1) {
+                copies[3 * w + corner] = w;
+            } else {
+                if (numvertices == size) {
+                    size *= 2;
+                    *sources = (GLuint*)realloc(*sources, sizeof(GLuint) * size);
+                    *corners = (GLfloat*)realloc(*corners, sizeof(GLfloat) * size);
+                }
+                (*sources)[numvertices] = w;
+                copies[3 * w + corner] = numvertices++;
+            }
+            (*corners)[copies[3 * w + corner]] = (GLfloat)corner;
+            indices[3 * t + j] = copies[3 * w + corner];
+        }
+    }
+    free(copies);
+
+    return numvertices;
+}
+
+
+/* public functions */
+
+
+/* mtCreate: Uploads a basis as vertex attributes of a welded model and
+ * compiles the blending shader.
+ *
+ * basis   - basis prepared with bsNormalBasis()
+ * indexed - the model welded with glmIndexed()
+ */
+MTshader*
+mtCreate(BSbasis* basis, GLMindexed* indexed)
+{
+    MTshader* shader;
+    GLuint program, u, k, j, v, numarrays;
+    GLuint* indices;
+    GLuint* sources;
+    GLfloat* corners;
+    GLfloat* data;
+    GLfloat* src;
+    char source[4096];
+
+    assert(basis);
+    assert(basis->normals);
+    assert(indexed);
+
+    if (basis->numcomponents > MT_MAX_COMPONENTS) {
+        fprintf(stderr, "mtCreate() failed: %u components, at most %d supported.\n",
+            basis->numcomponents, MT_MAX_COMPONENTS);
+        return NULL;
+    }
+
+    /* compile and link the program */
+    mtShaderSource(basis->numcomponents, 0, source);
+    program = mtLink(basis->numcomponents, source, "mtCreate");
+    if (!program)
+        return NULL;
+
+    shader = (MTshader*)malloc(sizeof(MTshader));
+    shader->basis = basis;
+    shader->numindices = indexed->numindices;
+    shader->program = program;
+    shader->weights = glGetUniformLocation(shader->program, "weights");
+    shader->scale = glGetUniformLocation(shader->program, "scale");
+    shader->center = glGetUniformLocation(shader->program, "center");
+    shader->linewidthlocation = glGetUniformLocation(shader->program, "linewidth");
+    shader->linecolorlocation = glGetUniformLocation(shader->program, "linecolor");
+    shader->linewidth = 0.0f;
+    shader->linecolor[0] = 0.6f;
+    shader->linecolor[1] = 0.0f;
+    shader->linecolor[2] = 0.8f;
+    shader->linecolor[3] = 1.0f;
+
+    indices = (GLuint*)malloc(sizeof(GLuint) * indexed->numindices);
+    memcpy(indices, indexed->indices, sizeof(GLuint) * indexed->numindices);
+    shader->numvertices = mtCorners(indexed, indices, &sources, &corners);
+
+    /* gather the attributes of every vertex, one array after the other
+       in attribute order */
+    numarrays = 2 * (basis->numcomponents + 1);
+    data = (GLfloat*)malloc(sizeof(GLfloat) * shader->numvertices * (3 * numarrays + 1));
+    for (k = 0; k < numarrays; k++) {
+        if (k == 0)
+            src = basis->mean;
+        else if (k == 1)
+            src = basis->normals;
+        else if (k % 2 == 0)
+            src = basis->components[(k - 2) / 2];
+        else
+            src = basis->normaldeltas[(k - 2) / 2];
+        for (u = 0; u < shader->numvertices; u++) {
+            v = indexed->vindices[sources[u]] - 1;
+            for (j = 0; j < 3; j++)
+                data[3 * (k * shader->numvertices + u) + j] = src[3 * v + j];
+        }
+    }
+    memcpy(&data[3 * numarrays * shader->numvertices], corners,
+        sizeof(GLfloat) * shader->numvertices);
+
+    glGenBuffers(1, &shader->attributebuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, shader->attributebuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * shader->numvertices * (3 * numarrays + 1),
+        data, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    free(data);
+
+    glGenBuffers(1, &shader->indexbuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, shader->indexbuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indexed->numindices,
+        indices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    free(indices);
+    free(sources);
+    free(corners);
+
+    return shader;
+}
+
+/* mtDraw: Renders the blended shape for a set of weights, with the
+ * wireframe on top if linewidth is set.
+ *
+ * shader  - structure created with mtCreate()
+ * weights - array of numcomponents GLfloats
+ */
+GLvoid
+mtDraw(MTshader* shader, GLfloat* weights)
+{
+    assert(shader);
+    assert(weights);
+
+    glUseProgram(shader->program);
+    glUniform1fv(shader->weights, shader->basis->numcomponents, weights);
+    glUniform1f(shader->scale, shader->basis->scale);
+    glUniform3fv(shader->center, 1, shader->basis->center);
+    glUniform1f(shader->linewidthlocation, shader->linewidth);
+    glUniform4fv(shader->linecolorlocation, 1, shader->linecolor);
+
+    mtBindAttributes(shader);
+    glDrawElements(GL_TRIANGLES, shader->numindices, GL_UNSIGNED_INT, (GLvoid*)0);
+    mtUnbindAttributes(shader);
+    glUseProgram(0);
+}
+
+/* mtDelete: Deletes a MTshader structure and its GL objects.
+ *
+ * shader - structure created with mtCreate()
+ */
+GLvoid
+mtDelete(MTshader* shader)
+{
+    assert(shader);
+
+    glDeleteProgram(shader->program);
+    glDeleteBuffers(1, &shader->attributebuffer);
+    glDeleteBuffers(1, &shader->indexbuffer);
+    free(shader);
+}
+
+/* mtCrowdCreate: Compiles the crowd shader for the buffers of a
+ * MTshader.
+ *
+ * shader - structure created with mtCreate()
+ */
+MTcrowd*
+mtCrowdCreate(MTshader* shader)
+{
+    MTcrowd* crowd;
+    GLuint program, numcomponents;
+    const char* extensions;
+    char source[4096];
+
+    assert(shader);
+
+    numcomponents = shader->basis->numcomponents;
+    program = 0;
+    extensions = (const char*)glGetString(GL_EXTENSIONS);
+    if (extensions && strstr(extensions, "GL_ARB_draw_instanced")) {
+        mtShaderSource(numcomponents, MT_CROWD_INSTANCED, source);
+        program = mtLink(numcomponents, source, "mtCrowdCreate");
+    }
+    crowd = (MTcrowd*)malloc(sizeof(MTcrowd));
+    crowd->instanced = program ? GL_TRUE : GL_FALSE;
+    if (!program) {
+        mtShaderSource(numcomponents, MT_CROWD_LOOP, source);
+        program = mtLink(numcomponents, source, "mtCrowdCreate");
+        if (!program) {
+            free(crowd);
+            return NULL;
+        }
+    }
+
+    crowd->shader = shader;
+    crowd->program = program;
+    crowd->weights = glGetUniformLocation(program, "weights");
+    crowd->transforms = glGetUniformLocation(program, "transforms");
+    crowd->instance = glGetUniformLocation(program, "instance");
+    crowd->scale = glGetUniformLocation(program, "scale");
+    crowd->center = glGetUniformLocation(program, "center");
+    crowd->linewidthlocation = glGetUniformLocation(program, "linewidth");
+    crowd->linecolorlocation = glGetUniformLocation(program, "linecolor");
+
+    return crowd;
+}
+
+/* mtCrowdDraw: Renders a number of instances, each with its own
+ * weights and a transform applied before the modelview matrix.  The
+ * wireframe follows the linewidth and linecolor of the MTshader.
+ *
+ * crowd        - structure created with mtCrowdCreate()
+ * numinstances - number of instances
+ * transforms   - array of 16 * numinstances GLfloats (column major)
+ * weights      - array of numcomponents * numinstances GLfloats
+ */
+GLvoid
+mtCrowdDraw(MTcrowd* crowd, GLuint numinstances, GLfloat* transforms, GLfloat* weights)
+{
+    MTshader* shader;
+    GLuint first, count, i, numcomponents;
+
+    assert(crowd);
+    assert(transforms);
+    assert(weights);
+
+    shader = crowd->shader;
+    numcomponents = shader->basis->numcomponents;
+
+    glUseProgram(crowd->program);
+    glUniform1f(crowd->scale, shader->basis->scale);
+    glUniform3fv(crowd->center, 1, shader->basis->center);
+    glUniform1f(crowd->linewidthlocation, shader->linewidth);
+    glUniform4fv(crowd->linecolorlocation, 1, shader->linecolor);
+    mtBindAttributes(shader);
+
+    for (first = 0; first < numinstances; first += MT_CROWD_BATCH) {
+        count = numinstances - first < MT_CROWD_BATCH ? numinstances - first : MT_CROWD_BATCH;
+        glUniform1fv(crowd->weights, count * numcomponents, &weights[numcomponents * first]);
+        glUniformMatrix4fv(crowd->transforms, count, GL_FALSE, &transforms[16 * first]);
+        if (crowd->instanced) {
+            glDrawElementsInstancedARB(GL_TRIANGLES, shader->numindices, GL_UNSIGNED_INT,
+                (GLvoid*)0, count);
+        } else {
+            for (i = 0; i < count; i++) {
+                glUniform1i(crowd->instance, i);
+                glDrawElements(GL_TRIANGLES, shader->numindices, GL_UNSIGNED_INT, (GLvoid*)0);
+            }
+        }
+    }
+
+    mtUnbindAttributes(shader);
+    glUseProgram(0);
+}
+
+/* mtCrowdGrid: Lays out instances on a square grid that covers the
+ * space a single unitized model occupies.
+ *
+ * numinstances - number of instances
+ * transforms   - array of 16 * numinstances GLfloats to write to
+ */
+GLvoid
+mtCrowdGrid(GLuint numinstances, GLfloat* transforms)
+{
+    GLuint columns, rows, i, j;
+    GLfloat cell;
+    GLfloat* t;
+
+    assert(transforms);
+
+    if (numinstances == 0)
+        return;
+    columns = (GLuint)ceil(sqrt((double)numinstances));
+    rows = (numinstances + columns - 1) / columns;
+    cell = 2.0f / columns;
+
+    /* a unitized model spans [-1, 1], so it is scaled to half a cell */
+    for (i = 0; i < numinstances; i++) {
+        t = &transforms[16 * i];
+        for (j = 0; j < 16; j++)
+            t[j] = 0.0f;
+        t[0] = t[5] = t[10] = cell / 2.0f;
+        t[12] = -1.0f + cell * (i % columns + 0.5f);
+        t[13] = cell * rows / 2.0f - cell * (i / columns + 0.5f);
+        t[15] = 1.0f;
+    }
+}
+
+/* mtCrowdDelete: Deletes a MTcrowd structure and its program.
+ *
+ * crowd - structure created with mtCrowdCreate()
+ */
+GLvoid
+mtCrowdDelete(MTcrowd* crowd)
+{
+    assert(crowd);
+
+    glDeleteProgram(crowd->program);
+    free(crowd);
+}
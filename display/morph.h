@@ -0,0 +1,153 @@
+/*
+      morph.h
+
+      Blendshape evaluation in a vertex shader.
+
+      The mean shape, the components and their normal derivatives (see
+      bsNormalBasis()) are uploaded once as static vertex attributes of
+      the welded model; per frame only the component weights and the
+      unitize transform are sent as uniforms.  The shader lights the
+      vertices like the fixed-function pipeline does for the single
+      directional light used by Display(), and the fragment shader only
+      passes the color on, so the shading is the same Gouraud shading
+      as the CPU path.
+
+      The fragment shader can overlay the wireframe in the same pass:
+      every vertex carries the number (0, 1 or 2) of the corner it is
+      in its triangles, and the distance to the nearest edge follows
+      from the interpolated barycentric coordinates and their screen
+      space derivatives.  Vertices whose triangles need different
+      numbers are duplicated, about half again as many for the head.
+
+      The vertex arrays are plain GL 2.1 attributes (GLSL 1.20), which is
+      what the macOS legacy context offers; buffer textures and SSBOs
+      are not available there.  Each component takes two attributes, so
+      with the mean, its normal and the corner number a basis can have
+      at most MT_MAX_COMPONENTS components.
+
+      The shader applies the scale and center of the basis as uniforms,
+      so with a basis unitized by bsUnitize() it draws in the same fixed
+      frame as the CPU blend and nothing runs on the CPU per frame.
+
+      A crowd (MTcrowd) draws many instances of the same basis with
+      their own weights and transform.  Everything but the per-instance
+      uniforms is shared with the MTshader, and instances are drawn in
+      batches of MT_CROWD_BATCH, with one instanced draw per batch when
+      GL_ARB_draw_instanced is available.
+
+ */
+
+#ifndef MORPH_H
+#define MORPH_H
+
+#include "glm.h"
+#include "blend.h"
+
+
+#define MT_MAX_COMPONENTS 6     /* 2 * (6 + 1) + 1 attributes fit in the 16 guaranteed */
+#define MT_CROWD_BATCH 12       /* instances per batch, within 512 uniform components */
+
+
+/* MTshader: Structure that defines a shader-evaluated blendshape.
+ */
+typedef struct _MTshader {
+  BSbasis* basis;               /* basis the attributes were built from */
+  GLuint   numvertices;         /* number of welded vertices and their copies */
+  GLuint   numindices;          /* number of indices */
+
+  GLuint   program;             /* GLSL program */
+  GLuint   indexbuffer;         /* static element array buffer */
+  GLuint   attributebuffer;     /* static mean/components/normal deltas */
+  GLint    weights;             /* location of the weights uniform */
+  GLint    scale;               /* location of the basis scale uniform */
+  GLint    center;              /* location of the basis center uniform */
+  GLint    linewidthlocation;   /* location of the line width uniform */
+  GLint    linecolorlocation;   /* location of the line color uniform */
+
+  GLfloat  linewidth;           /* wireframe width in pixels, 0 for none */
+  GLfloat  linecolor[4];        /* wireframe color, alpha blends it in */
+} MTshader;
+
+/* MTcrowd: Structure that defines a crowd of shader-evaluated blendshapes.
+ */
+typedef struct _MTcrowd {
+  MTshader* shader;             /* shader whose buffers the crowd shares */
+  GLuint   program;             /* GLSL program */
+  GLboolean instanced;          /* GL_TRUE if batches use instanced draws */
+  GLint    weights;             /* location of the weights uniform */
+  GLint    transforms;          /* location of the transforms uniform */
+  GLint    instance;            /* location of the instance uniform (-1 if instanced) */
+  GLint    scale;               /* location of the basis scale uniform */
+  GLint    center;              /* location of the basis center uniform */
+  GLint    linewidthlocation;   /* location of the line width uniform */
+  GLint    linecolorlocation;   /* location of the line color uniform */
+} MTcrowd;
+
+
+/* mtCreate: Uploads a basis as vertex attributes of a welded model and
+ * compiles the blending shader.  The basis must have been prepared
+ * with bsNormalBasis().  Requires a current GL context.  Returns NULL
+ * if the shader fails to compile, otherwise a pointer to the created
+ * structure which should be free'd with mtDelete().
+ *
+ * basis   - basis prepared with bsNormalBasis()
+ * indexed - the model welded with glmIndexed()
+ */
+MTshader*
+mtCreate(BSbasis* basis, GLMindexed* indexed);
+
+/* mtDraw: Renders the blended shape for a set of weights, with the
+ * wireframe on top if linewidth is set.
+ *
+ * shader  - structure created with mtCreate()
+ * weights - array of numcomponents GLfloats
+ */
+GLvoid
+mtDraw(MTshader* shader, GLfloat* weights);
+
+/* mtDelete: Deletes a MTshader structure and its GL objects.
+ *
+ * shader - structure created with mtCreate()
+ */
+GLvoid
+mtDelete(MTshader* shader);
+
+/* mtCrowdCreate: Compiles the crowd shader for the buffers of a
+ * MTshader.  Returns NULL if the shader fails to compile, otherwise a
+ * pointer to the created structure which should be free'd with
+ * mtCrowdDelete() before the MTshader is.
+ *
+ * shader - structure created with mtCreate()
+ */
+MTcrowd*
+mtCrowdCreate(MTshader* shader);
+
+/* mtCrowdDraw: Renders a number of instances, each with its own
+ * weights and a transform applied before the modelview matrix.  The
+ * wireframe follows the linewidth and linecolor of the MTshader.
+ *
+ * crowd        - structure created with mtCrowdCreate()
+ * numinstances - number of instances
+ * transforms   - array of 16 * numinstances GLfloats (column major)
+ * weights      - array of numcomponents * numinstances GLfloats
+ */
+GLvoid
+mtCrowdDraw(MTcrowd* crowd, GLuint numinstances, GLfloat* transforms, GLfloat* weights);
+
+/* mtCrowdGrid: Lays out instances on a square grid that covers the
+ * space a single unitized model occupies.
+ *
+ * numinstances - number of instances
+ * transforms   - array of 16 * numinstances GLfloats to write to
+ */
+GLvoid
+mtCrowdGrid(GLuint numinstances, GLfloat* transforms);
+
+/* mtCrowdDelete: Deletes a MTcrowd structure and its program.
+ *
+ * crowd - structure created with mtCrowdCreate()
+ */
+GLvoid
+mtCrowdDelete(MTcrowd* crowd);
+
+#endif
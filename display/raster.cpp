@@ -0,0 +1,667 @@
+/*
+      raster.cpp
+
+      Tile-based software rasterizer for welded models.
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "raster.h"
+
+
+/* phases run by the thread pool */
+#define SR_CLEAR   0
+#define SR_VERTEX  1
+#define SR_BIN     2
+#define SR_RASTER  3
+#define SR_QUIT    4
+
+
+/* SRedge: edge function of a triangle edge, evaluated from its
+ * canonical endpoint a (the one with the smaller x, then y):
+ *
+ *     E(x, y) = sign * (dx * (y - ay) - dy * (x - ax))
+ */
+typedef struct _SRedge {
+    GLfloat ax, ay;             /* canonical endpoint */
+    GLfloat dx, dy;             /* canonical direction */
+    GLfloat sign;               /* -1 if the triangle runs the edge backwards */
+    GLboolean owner;            /* whether E == 0 is inside (top-left rule) */
+} SRedge;
+
+
+/* srEdge: set up the edge from p to q of a counter-clockwise triangle */
+static GLvoid
+srEdge(SRedge* edge, GLfloat* p, GLfloat* q)
+{
+    GLfloat* a;
+    GLfloat* b;
+    GLfloat A, B;
+
+    if (p[0] < q[0] || (p[0] == q[0] && p[1] < q[1])) {
+        a = p;
+        b = q;
+        edge->sign = 1.0f;
+    } else {
+        a = q;
+        b = p;
+        edge->sign = -1.0f;
+    }
+    edge->ax = a[0];
+    edge->ay = a[1];
+    edge->dx = b[0] - a[0];
+    edge->dy = b[1] - a[1];
+
+    /* the triangle on the other side runs the edge the opposite way,
+       so exactly one of them owns pixels centered on it */
+    A = p[1] - q[1];
+    B = q[0] - p[0];
+    edge->owner = A > 0.0f || (A == 0.0f && B < 0.0f);
+}
+
+/* srBounds: pixels whose centers may be covered by a triangle
+ *
+ * returns GL_FALSE if there are none
+ */
+static GLboolean
+srBounds(SRcontext* context, GLfloat* v0, GLfloat* v1, GLfloat* v2,
+         GLint* xmin, GLint* ymin, GLint* xmax, GLint* ymax)
+{
+    GLfloat minx, miny, maxx, maxy;
+
+    minx = v0[0] < v1[0] ? v0[0] : v1[0];
+    minx = minx < v2[0] ? minx : v2[0];
+    maxx = v0[0] > v1[0] ? v0[0] : v1[0];
+    maxx = maxx > v2[0] ? maxx : v2[0];
+    miny = v0[1] < v1[1] ? v0[1] : v1[1];
+    miny = miny < v2[1] ? miny : v2[1];
+    maxy = v0[1] > v1[1] ? v0[1] : v1[1];
+    maxy = maxy > v2[1] ? maxy : v2[1];
+
+    /* pixel x covers the center x + 0.5 */
+    *xmin = (GLint)ceil(minx - 0.5f);
+    *xmax = (GLint)floor(maxx - 0.5f);
+    *ymin = (GLint)ceil(miny - 0.5f);
+    *ymax = (GLint)floor(maxy - 0.5f);
+    if (*xmin < 0) *xmin = 0;
+    if (*ymin < 0) *ymin = 0;
+    if (*xmax > (GLint)context->width - 1) *xmax = context->width - 1;
+    if (*ymax > (GLint)context->height - 1) *ymax = context->height - 1;
+
+    return *xmin <= *xmax && *ymin <= *ymax;
+}
+
+/* srTriangle: rasterize the part of a triangle inside a tile */
+static GLvoid
+srTriangle(SRcontext* context, GLuint triangle, GLint tx0, GLint ty0,
+           GLint tx1, GLint ty1)
+{
+    GLuint* indices;
+    GLfloat* v[3];
+    GLfloat* c[3];
+    GLfloat* swap;
+    GLfloat area, invarea, py, row[3], invlength[3], reach;
+    GLint xmin, ymin, xmax, ymax, x, y, i;
+    SRedge edges[3];
+
+    indices = &context->indexed->indices[3 * triangle];
+    for (i = 0; i < 3; i++) {
+        v[i] = &context->screen[4 * indices[i]];
+        c[i] = &context->lit[3 * indices[i]];
+    }
+
+    /* no culling: turn clockwise triangles around */
+    area = (v[1][0] - v[0][0]) * (v[2][1] - v[0][1]) -
+           (v[1][1] - v[0][1]) * (v[2][0] - v[0][0]);
+    if (area == 0.0f)
+        return;
+    if (area < 0.0f) {
+        swap = v[1]; v[1] = v[2]; v[2] = swap;
+        swap = c[1]; c[1] = c[2]; c[2] = swap;
+        area = -area;
+    }
+    invarea = 1.0f / area;
+
+    /* edge i is opposite vertex i */
+    srEdge(&edges[0], v[1], v[2]);
+    srEdge(&edges[1], v[2], v[0]);
+    srEdge(&edges[2], v[0], v[1]);
+
+    /* E / |d| is the distance of a pixel from the edge; the wireframe
+       fades in over the pixel beyond linewidth / 2 like the shader's
+       in morph.h */
+    for (i = 0; i < 3; i++)
+        invlength[i] = 1.0f / (GLfloat)sqrt(edges[i].dx * edges[i].dx + edges[i].dy * edges[i].dy);
+    reach = 0.5f * context->linewidth + 0.5f;
+
+    if (!srBounds(context, v[0], v[1], v[2], &xmin, &ymin, &xmax, &ymax))
+        return;
+    if (xmin < tx0) xmin = tx0;
+    if (ymin < ty0) ymin = ty0;
+    if (xmax > tx1 - 1) xmax = tx1 - 1;
+    if (ymax > ty1 - 1) ymax = ty1 - 1;
+    if (xmin > xmax || ymin > ymax)
+        return;
+
+#ifdef __SSE2__
+    {
+        __m128 lane, zero, one, scale, left, right, px, e[3], b[3], q[3];
+        __m128 inside, t, z, depth, s, r, g, bl, a;
+        __m128 owner[3];
+        GLfloat* d;
+        GLubyte* pixel;
+        GLint mask, l;
+        int rgb[3][4];
+
+        lane = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+        zero = _mm_setzero_ps();
+        one = _mm_set1_ps(1.0f);
+        scale = _mm_set1_ps(255.0f);
+        left = _mm_set1_ps(xmin + 0.5f);
+        right = _mm_set1_ps(xmax + 0.5f);
+        for (i = 0; i < 3; i++)
+            owner[i] = _mm_castsi128_ps(_mm_set1_epi32(edges[i].owner ? -1 : 0));
+
+        for (y = ymin; y <= ymax; y++) {
+            py = y + 0.5f;
+            for (i = 0; i < 3; i++)
+                row[i] = edges[i].dx * (py - edges[i].ay);
+
+            /* aligned groups of 4, masked to [xmin, xmax] */
+            for (x = xmin & ~3; x <= xmax; x += 4) {
+                px = _mm_add_ps(_mm_set1_ps(x + 0.5f), lane);
+                inside = _mm_and_ps(_mm_cmpge_ps(px, left), _mm_cmple_ps(px, right));
+                for (i = 0; i < 3; i++) {
+                    t = _mm_mul_ps(_mm_set1_ps(edges[i].dy),
+                                   _mm_sub_ps(px, _mm_set1_ps(edges[i].ax)));
+                    e[i] = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(row[i]), t),
+                                      _mm_set1_ps(edges[i].sign));
+                    inside = _mm_and_ps(inside, _mm_or_ps(_mm_cmpgt_ps(e[i], zero),
+                        _mm_and_ps(_mm_cmpeq_ps(e[i], zero), owner[i])));
+                }
+                if (!_mm_movemask_ps(inside))
+                    continue;
+
+                for (i = 0; i < 3; i++)
+                    b[i] = _mm_mul_ps(e[i], _mm_set1_ps(invarea));
+                z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(b[0], _mm_set1_ps(v[0][2])),
+                                          _mm_mul_ps(b[1], _mm_set1_ps(v[1][2]))),
+                               _mm_mul_ps(b[2], _mm_set1_ps(v[2][2])));
+                d = &context->depth[y * context->stride + x];
+                depth = _mm_loadu_ps(d);
+                inside = _mm_and_ps(inside, _mm_cmplt_ps(z, depth));
+                mask = _mm_movemask_ps(inside);
+                if (!mask)
+                    continue;
+                _mm_storeu_ps(d, _mm_or_ps(_mm_and_ps(inside, z), _mm_andnot_ps(inside, depth)));
+
+                /* perspective correct colors */
+                for (i = 0; i < 3; i++)
+                    q[i] = _mm_mul_ps(b[i], _mm_set1_ps(v[i][3]));
+                s = _mm_div_ps(one, _mm_add_ps(_mm_add_ps(q[0], q[1]), q[2]));
+                r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(q[0], _mm_set1_ps(c[0][0])),
+                                          _mm_mul_ps(q[1], _mm_set1_ps(c[1][0]))),
+                               _mm_mul_ps(q[2], _mm_set1_ps(c[2][0])));
+                g = _mm_add_ps(_mm_add_ps(_mm_mul_ps(q[0], _mm_set1_ps(c[0][1])),
+                                          _mm_mul_ps(q[1], _mm_set1_ps(c[1][1]))),
+                               _mm_mul_ps(q[2], _mm_set1_ps(c[2][1])));
+                bl = _mm_add_ps(_mm_add_ps(_mm_mul_ps(q[0], _mm_set1_ps(c[0][2])),
+                                           _mm_mul_ps(q[1], _mm_set1_ps(c[1][2]))),
+                                _mm_mul_ps(q[2], _mm_set1_ps(c[2][2])));
+                r = _mm_min_ps(_mm_max_ps(_mm_mul_ps(r, s), zero), one);
+                g = _mm_min_ps(_mm_max_ps(_mm_mul_ps(g, s), zero), one);
+                bl = _mm_min_ps(_mm_max_ps(_mm_mul_ps(bl, s), zero), one);
+                if (context->linewidth > 0.0f) {
+                    a = _mm_min_ps(_mm_mul_ps(e[0], _mm_set1_ps(invlength[0])),
+                                   _mm_mul_ps(e[1], _mm_set1_ps(invlength[1])));
+                    a = _mm_min_ps(a, _mm_mul_ps(e[2], _mm_set1_ps(invlength[2])));
+                    a = _mm_min_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(reach), a), zero), one);
+                    r = _mm_add_ps(r, _mm_mul_ps(a, _mm_sub_ps(_mm_set1_ps(context->linecolor[0]), r)));
+                    g = _mm_add_ps(g, _mm_mul_ps(a, _mm_sub_ps(_mm_set1_ps(context->linecolor[1]), g)));
+                    bl = _mm_add_ps(bl, _mm_mul_ps(a, _mm_sub_ps(_mm_set1_ps(context->linecolor[2]), bl)));
+                }
+                _mm_storeu_si128((__m128i*)rgb[0], _mm_cvtps_epi32(_mm_mul_ps(r, scale)));
+                _mm_storeu_si128((__m128i*)rgb[1], _mm_cvtps_epi32(_mm_mul_ps(g, scale)));
+                _mm_storeu_si128((__m128i*)rgb[2], _mm_cvtps_epi32(_mm_mul_ps(bl, scale)));
+
+                pixel = &context->color[3 * (y * context->width + x)];
+                for (l = 0; l < 4; l++, pixel += 3) {
+                    if (!(mask & (1 << l)))
+                        continue;
+                    pixel[0] = (GLubyte)rgb[0][l];
+                    pixel[1] = (GLubyte)rgb[1][l];
+                    pixel[2] = (GLubyte)rgb[2][l];
+                }
+            }
+        }
+    }
+#else
+    {
+        GLfloat px, e[3], b[3], q[3], z, s, value, a;
+        GLfloat* d;
+        GLubyte* pixel;
+        GLint j;
+
+        for (y = ymin; y <= ymax; y++) {
+            py = y + 0.5f;
+            for (i = 0; i < 3; i++)
+                row[i] = edges[i].dx * (py - edges[i].ay);
+
+            for (x = xmin; x <= xmax; x++) {
+                px = x + 0.5f;
+                for (i = 0; i < 3; i++) {
+                    e[i] = (row[i] - edges[i].dy * (px - edges[i].ax)) * edges[i].sign;
+                    if (e[i] < 0.0f || (e[i] == 0.0f && !edges[i].owner))
+                        break;
+                }
+                if (i < 3)
+                    continue;
+
+                for (i = 0; i < 3; i++)
+                    b[i] = e[i] * invarea;
+                z = b[0] * v[0][2] + b[1] * v[1][2] + b[2] * v[2][2];
+                d = &context->depth[y * context->stride + x];
+                if (!(z < *d))
+                    continue;
+                *d = z;
+
+                for (i = 0; i < 3; i++)
+                    q[i] = b[i] * v[i][3];
+                s = 1.0f / (q[0] + q[1] + q[2]);
+                a = 0.0f;
+                if (context->linewidth > 0.0f) {
+                    a = e[0] * invlength[0];
+                    a = a < e[1] * invlength[1] ? a : e[1] * invlength[1];
+                    a = a < e[2] * invlength[2] ? a : e[2] * invlength[2];
+                    a = reach - a;
+                    a = a < 0.0f ? 0.0f : a > 1.0f ? 1.0f : a;
+                }
+                pixel = &context->color[3 * (y * context->width + x)];
+                for (j = 0; j < 3; j++) {
+                    value = (q[0] * c[0][j] + q[1] * c[1][j] + q[2] * c[2][j]) * s;
+                    value = value < 0.0f ? 0.0f : value > 1.0f ? 1.0f : value;
+                    value += a * (context->linecolor[j] - value);
+                    pixel[j] = (GLubyte)(value * 255.0f + 0.5f);
+                }
+            }
+        }
+    }
+#endif
+}
+
+/* srTransform: out = m * (x, y, z, w) for a column major 4x4 matrix */
+static GLvoid
+srTransform(GLfloat* m, GLfloat x, GLfloat y, GLfloat z, GLfloat w, GLfloat* out)
+{
+    GLuint i;
+
+    for (i = 0; i < 4; i++)
+        out[i] = m[i] * x + m[4 + i] * y + m[8 + i] * z + m[12 + i] * w;
+}
+
+/* srWork: the share of a phase run by one thread */
+static GLvoid
+srWork(SRcontext* context, GLuint phase, GLuint index)
+{
+    GLMindexed* indexed;
+    GLuint numtiles, tile, first, last, u, t, k, n;
+    GLint tx0, ty0, tx1, ty1, x, y, xmin, ymin, xmax, ymax;
+    GLfloat mvp[16], normal[9], clip[4], eye[3], det, diffuse, value;
+    GLfloat* m;
+    GLfloat* p;
+    GLfloat* s[3];
+    GLfloat* out;
+    GLuint* indices;
+    GLubyte* pixel;
+    GLubyte clear[3];
+    SRbin* bin;
+
+    indexed = context->indexed;
+    numtiles = context->tilesx * context->tilesy;
+    n = context->numthreads;
+
+    switch (phase) {
+    case SR_CLEAR:
+        for (k = 0; k < 3; k++)
+            clear[k] = (GLubyte)(context->clearcolor[k] * 255.0f + 0.5f);
+        while ((tile = __sync_fetch_and_add(&context->nexttile, 1)) < numtiles) {
+            tx0 = (tile % context->tilesx) * SR_TILE;
+            ty0 = (tile / context->tilesx) * SR_TILE;
+            tx1 = tx0 + SR_TILE < (GLint)context->width ? tx0 + SR_TILE : context->width;
+            ty1 = ty0 + SR_TILE < (GLint)context->height ? ty0 + SR_TILE : context->height;
+            for (y = ty0; y < ty1; y++) {
+                pixel = &context->color[3 * (y * context->width + tx0)];
+                for (x = tx0; x < tx1; x++, pixel += 3) {
+                    pixel[0] = clear[0];
+                    pixel[1] = clear[1];
+                    pixel[2] = clear[2];
+                    context->depth[y * context->stride + x] = 1.0f;
+                }
+            }
+        }
+        break;
+
+    case SR_VERTEX:
+        /* every thread derives the same matrices */
+        for (k = 0; k < 4; k++)
+            srTransform(context->projection, context->modelview[4 * k + 0],
+                        context->modelview[4 * k + 1], context->modelview[4 * k + 2],
+                        context->modelview[4 * k + 3], &mvp[4 * k]);
+
+        /* normal matrix: inverse transpose of the upper 3x3, which is
+           its cofactor matrix over the determinant */
+        m = context->modelview;
+        normal[0] = m[5] * m[10] - m[6] * m[9];
+        normal[1] = m[6] * m[8] - m[4] * m[10];
+        normal[2] = m[4] * m[9] - m[5] * m[8];
+        normal[3] = m[9] * m[2] - m[10] * m[1];
+        normal[4] = m[10] * m[0] - m[8] * m[2];
+        normal[5] = m[8] * m[1] - m[9] * m[0];
+        normal[6] = m[1] * m[6] - m[2] * m[5];
+        normal[7] = m[2] * m[4] - m[0] * m[6];
+        normal[8] = m[0] * m[5] - m[1] * m[4];
+        det = m[0] * normal[0] + m[1] * normal[1] + m[2] * normal[2];
+        for (k = 0; k < 9; k++)
+            normal[k] /= det;
+
+        first = indexed->numvertices * index / n;
+        last = indexed->numvertices * (index + 1) / n;
+        for (u = first; u < last; u++) {
+            p = &indexed->vertices[3 * u];
+            out = &context->screen[4 * u];
+            srTransform(mvp, p[0], p[1], p[2], 1.0f, clip);
+            if (clip[3] <= 0.0f || clip[2] < -clip[3] || clip[2] > clip[3]) {
+                out[3] = 0.0f;  /* beyond the near or far plane */
+            } else {
+                out[3] = 1.0f / clip[3];
+                out[0] = (clip[0] * out[3] + 1.0f) * 0.5f * context->width;
+                out[1] = (clip[1] * out[3] + 1.0f) * 0.5f * context->height;
+                out[2] = (clip[2] * out[3] + 1.0f) * 0.5f;
+            }
+
+            /* GL_COLOR_MATERIAL: ambient and diffuse follow the color */
+            p = &indexed->normals[3 * u];
+            for (k = 0; k < 3; k++)
+                eye[k] = normal[3 * k + 0] * p[0] + normal[3 * k + 1] * p[1] +
+                         normal[3 * k + 2] * p[2];
+            diffuse = eye[0] * context->lightdirection[0] +
+                      eye[1] * context->lightdirection[1] +
+                      eye[2] * context->lightdirection[2];
+            if (diffuse < 0.0f)
+                diffuse = 0.0f;
+            out = &context->lit[3 * u];
+            for (k = 0; k < 3; k++) {
+                value = context->vertexcolor[k] *
+                    (context->lightmodelambient[k] + context->lightambient[k] +
+                     diffuse * context->lightdiffuse[k]);
+                out[k] = value > 1.0f ? 1.0f : value;
+            }
+        }
+        break;
+
+    case SR_BIN:
+        for (tile = 0; tile < numtiles; tile++)
+            context->bins[tile * n + index].numtriangles = 0;
+
+        first = indexed->numindices / 3 * index / n;
+        last = indexed->numindices / 3 * (index + 1) / n;
+        for (t = first; t < last; t++) {
+            indices = &indexed->indices[3 * t];
+            for (k = 0; k < 3; k++) {
+                s[k] = &context->screen[4 * indices[k]];
+                if (s[k][3] == 0.0f)
+                    break;
+            }
+            if (k < 3)
+                continue;
+            if (!srBounds(context, s[0], s[1], s[2], &xmin, &ymin, &xmax, &ymax))
+                continue;
+
+            for (y = ymin / SR_TILE; y <= ymax / SR_TILE; y++) {
+                for (x = xmin / SR_TILE; x <= xmax / SR_TILE; x++) {
+                    bin = &context->bins[(y * context->tilesx + x) * n + index];
+                    if (bin->numtriangles == bin->size) {
+                        bin->size = bin->size ? 2 * bin->size : 64;
+                        bin->triangles = (GLuint*)realloc(bin->triangles,
+                            sizeof(GLuint) * bin->size);
+                    }
+                    bin->triangles[bin->numtriangles++] = t;
+                }
+            }
+        }
+        break;
+
+    case SR_RASTER:
+        while ((tile = __sync_fetch_and_add(&context->nexttile, 1)) < numtiles) {
+            tx0 = (tile % context->tilesx) * SR_TILE;
+            ty0 = (tile / context->tilesx) * SR_TILE;
+            tx1 = tx0 + SR_TILE;
+            ty1 = ty0 + SR_TILE;
+
+            /* the bins of thread 0, 1, ... hold consecutive ranges of
+               triangles, so this is submission order */
+            for (k = 0; k < n; k++) {
+                bin = &context->bins[tile * n + k];
+                for (t = 0; t < bin->numtriangles; t++)
+                    srTriangle(context, bin->triangles[t], tx0, ty0, tx1, ty1);
+            }
+        }
+        break;
+    }
+}
+
+/* srWorker: thread function of the pool */
+static GLvoid*
+srWorker(GLvoid* arg)
+{
+    SRcontext* context;
+    GLuint index, seen, phase;
+
+    context = (SRcontext*)arg;
+    index = __sync_add_and_fetch(&context->nextworker, 1);
+    seen = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&context->mutex);
+        while (context->generation == seen)
+            pthread_cond_wait(&context->start, &context->mutex);
+        seen = context->generation;
+        phase = context->phase;
+        pthread_mutex_unlock(&context->mutex);
+
+        if (phase == SR_QUIT)
+            break;
+        srWork(context, phase, index);
+
+        pthread_mutex_lock(&context->mutex);
+        if (--context->running == 0)
+            pthread_cond_signal(&context->done);
+        pthread_mutex_unlock(&context->mutex);
+    }
+
+    return NULL;
+}
+
+/* srRun: run a phase on every thread and wait for it to finish */
+static GLvoid
+srRun(SRcontext* context, GLuint phase)
+{
+    context->nexttile = 0;
+    if (context->numthreads == 1) {
+        srWork(context, phase, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&context->mutex);
+    context->phase = phase;
+    context->running = context->numthreads - 1;
+    context->generation++;
+    pthread_cond_broadcast(&context->start);
+    pthread_mutex_unlock(&context->mutex);
+
+    srWork(context, phase, 0);
+
+    pthread_mutex_lock(&context->mutex);
+    while (context->running > 0)
+        pthread_cond_wait(&context->done, &context->mutex);
+    pthread_mutex_unlock(&context->mutex);
+}
+
+
+/* public functions */
+
+
+/* srCreate: Creates a render target and its thread pool.
+ *
+ * width      - width of the target in pixels
+ * height     - height of the target in pixels
+ * numthreads - threads to render with (0 for one per processor)
+ */
+SRcontext*
+srCreate(GLuint width, GLuint height, GLuint numthreads)
+{
+    SRcontext* context;
+    GLuint i, numbins;
+    long processors;
+
+    assert(width > 0 && height > 0);
+
+    if (numthreads == 0) {
+        processors = sysconf(_SC_NPROCESSORS_ONLN);
+        numthreads = processors > 0 ? (GLuint)processors : 1;
+    }
+
+    context = (SRcontext*)malloc(sizeof(SRcontext));
+    context->width = width;
+    context->height = height;
+    context->stride = (width + 3) & ~3;
+    context->color = (GLubyte*)malloc(3 * width * height);
+    context->depth = (GLfloat*)malloc(sizeof(GLfloat) * context->stride * height);
+
+    /* the state of Display() */
+    for (i = 0; i < 16; i++)
+        context->modelview[i] = context->projection[i] = i % 5 == 0 ? 1.0f : 0.0f;
+    for (i = 0; i < 3; i++) {
+        context->clearcolor[i] = 0.0f;
+        context->vertexcolor[i] = 1.0f;
+        context->lightmodelambient[i] = 0.2f;
+        context->lightambient[i] = 0.0f;
+        context->lightdiffuse[i] = 0.8f;
+        context->lightdirection[i] = i == 2 ? 1.0f : 0.0f;
+    }
+    context->linewidth = 0.0f;
+    context->linecolor[0] = 0.6f;
+    context->linecolor[1] = 0.0f;
+    context->linecolor[2] = 0.8f;
+
+    context->tilesx = (width + SR_TILE - 1) / SR_TILE;
+    context->tilesy = (height + SR_TILE - 1) / SR_TILE;
+    numbins = context->tilesx * context->tilesy * numthreads;
+    context->bins = (SRbin*)malloc(sizeof(SRbin) * numbins);
+    for (i = 0; i < numbins; i++) {
+        context->bins[i].numtriangles = 0;
+        context->bins[i].size = 0;
+        context->bins[i].triangles = NULL;
+    }
+    context->indexed = NULL;
+    context->numscreen = 0;
+    context->screen = NULL;
+    context->lit = NULL;
+
+    context->numthreads = numthreads;
+    context->phase = SR_CLEAR;
+    context->generation = 0;
+    context->running = 0;
+    context->nextworker = 0;
+    context->nexttile = 0;
+    pthread_mutex_init(&context->mutex, NULL);
+    pthread_cond_init(&context->start, NULL);
+    pthread_cond_init(&context->done, NULL);
+    context->threads = (pthread_t*)malloc(sizeof(pthread_t) * numthreads);
+    for (i = 1; i < numthreads; i++)
+        pthread_create(&context->threads[i], NULL, srWorker, context);
+
+    return context;
+}
+
+/* srClear: Clears the color and depth buffers.
+ *
+ * context - structure created with srCreate()
+ */
+GLvoid
+srClear(SRcontext* context)
+{
+    assert(context);
+
+    srRun(context, SR_CLEAR);
+}
+
+/* srDraw: Renders a welded model into the target.
+ *
+ * context - structure created with srCreate()
+ * indexed - structure created with glmIndexed(), with normals
+ */
+GLvoid
+srDraw(SRcontext* context, GLMindexed* indexed)
+{
+    assert(context);
+    assert(indexed);
+    assert(indexed->normals);
+
+    if (indexed->numvertices > context->numscreen) {
+        context->numscreen = indexed->numvertices;
+        context->screen = (GLfloat*)realloc(context->screen,
+            sizeof(GLfloat) * 4 * context->numscreen);
+        context->lit = (GLfloat*)realloc(context->lit,
+            sizeof(GLfloat) * 3 * context->numscreen);
+    }
+    context->indexed = indexed;
+
+    srRun(context, SR_VERTEX);
+    srRun(context, SR_BIN);
+    srRun(context, SR_RASTER);
+
+    context->indexed = NULL;
+}
+
+/* srDelete: Stops the threads and deletes a SRcontext structure.
+ *
+ * context - structure created with srCreate()
+ */
+GLvoid
+srDelete(SRcontext* context)
+{
+    GLuint i;
+
+    assert(context);
+
+    pthread_mutex_lock(&context->mutex);
+    context->phase = SR_QUIT;
+    context->generation++;
+    pthread_cond_broadcast(&context->start);
+    pthread_mutex_unlock(&context->mutex);
+    for (i = 1; i < context->numthreads; i++)
+        pthread_join(context->threads[i], NULL);
+
+    pthread_mutex_destroy(&context->mutex);
+    pthread_cond_destroy(&context->start);
+    pthread_cond_destroy(&context->done);
+    for (i = 0; i < context->tilesx * context->tilesy * context->numthreads; i++)
+        if (context->bins[i].triangles)
+            free(context->bins[i].triangles);
+    free(context->bins);
+    free(context->threads);
+    if (context->screen)
+        free(context->screen);
+    if (context->lit)
+        free(context->lit);
+    free(context->color);
+    free(context->depth);
+    free(context);
+}
@@ -0,0 +1,131 @@
+/*
+      raster.h
+
+      Tile-based software rasterizer for welded models.
+
+      srDraw() renders a GLMindexed like glmDrawIndexed() does under the
+      state Display() sets up: depth test (GL_LESS), one directional
+      light with GL_COLOR_MATERIAL, Gouraud shading and no culling.  It
+      needs no GL context, so headless renderers can run on machines
+      without a GPU or Mesa.
+
+      A frame runs in three phases on a pool of threads:
+
+        1. the vertices are transformed and lit, split evenly across
+           the threads;
+        2. every thread bins its share of the triangles into the screen
+           tiles their bounding boxes overlap;
+        3. the threads take tiles from a shared counter and rasterize
+           the triangles of each tile, in submission order, with edge
+           functions evaluated four pixels at a time (SSE2 where
+           available, one pixel at a time otherwise).
+
+      A tile belongs to one thread in phase 3, so the color and depth
+      buffers need no locking and the image does not depend on the
+      number of threads.  Edge functions are evaluated from a canonical
+      endpoint of every edge, so triangles that share an edge compute
+      exactly opposite values on it and no pixel is drawn twice or
+      missed.  The same edge functions, divided by the edge lengths,
+      give the distance to the nearest edge, so setting linewidth
+      draws the wireframe over the shading at no extra pass.
+
+      Triangles that cross the near or far plane are dropped rather
+      than clipped; the unitized head never reaches them.
+
+ */
+
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <pthread.h>
+#include "glm.h"
+
+
+#define SR_TILE 64              /* tile width and height in pixels */
+
+
+/* SRbin: Structure that holds the triangles overlapping a tile.
+ */
+typedef struct _SRbin {
+  GLuint   numtriangles;        /* number of triangles */
+  GLuint   size;                /* allocated size of triangles */
+  GLuint*  triangles;           /* triangle indices */
+} SRbin;
+
+/* SRcontext: Structure that defines a render target and its state.
+ */
+typedef struct _SRcontext {
+  GLuint   width;               /* width of the target in pixels */
+  GLuint   height;              /* height of the target in pixels */
+  GLubyte* color;               /* RGB rows, bottom first like glReadPixels() */
+  GLfloat* depth;               /* window depth, stride floats per row */
+  GLuint   stride;              /* depth row length (multiple of 4) */
+
+  GLfloat  modelview[16];       /* column major, like glLoadMatrixf() */
+  GLfloat  projection[16];      /* column major, like glLoadMatrixf() */
+  GLfloat  clearcolor[3];       /* glClearColor() */
+  GLfloat  vertexcolor[3];      /* glColor3f() */
+  GLfloat  lightmodelambient[3]; /* GL_LIGHT_MODEL_AMBIENT */
+  GLfloat  lightambient[3];     /* GL_AMBIENT of the light */
+  GLfloat  lightdiffuse[3];     /* GL_DIFFUSE of the light */
+  GLfloat  lightdirection[3];   /* eye space direction towards the light */
+  GLfloat  linewidth;           /* wireframe width in pixels, 0 for none */
+  GLfloat  linecolor[3];        /* wireframe color */
+
+  GLuint   numthreads;          /* threads rendering, including the caller */
+  pthread_t* threads;           /* worker threads */
+  pthread_mutex_t mutex;        /* guards the fields below */
+  pthread_cond_t  start;        /* signalled when a phase starts */
+  pthread_cond_t  done;         /* signalled when the last worker is done */
+  GLuint   phase;               /* phase the workers run */
+  GLuint   generation;          /* incremented for every phase */
+  GLuint   running;             /* workers still running the phase */
+  volatile GLuint nextworker;   /* index of the next worker to start */
+  volatile GLuint nexttile;     /* next tile to take in phase 3 */
+
+  GLuint   tilesx, tilesy;      /* number of tiles */
+  SRbin*   bins;                /* numthreads bins per tile */
+  GLMindexed* indexed;          /* model being drawn */
+  GLuint   numscreen;           /* allocated size of screen and lit */
+  GLfloat* screen;              /* x, y, z, 1/w per vertex */
+  GLfloat* lit;                 /* r, g, b per vertex */
+} SRcontext;
+
+
+/* srCreate: Creates a render target and its thread pool.  The state
+ * defaults to that of Display(): identity matrices, white vertex
+ * color, black background, a light along +z with 0.8 diffuse and no
+ * wireframe.
+ * Returns a pointer to the created structure which should be free'd
+ * with srDelete().
+ *
+ * width      - width of the target in pixels
+ * height     - height of the target in pixels
+ * numthreads - threads to render with (0 for one per processor)
+ */
+SRcontext*
+srCreate(GLuint width, GLuint height, GLuint numthreads);
+
+/* srClear: Clears the color and depth buffers.
+ *
+ * context - structure created with srCreate()
+ */
+GLvoid
+srClear(SRcontext* context);
+
+/* srDraw: Renders a welded model into the target.
+ *
+ * context - structure created with srCreate()
+ * indexed - structure created with glmIndexed(), with normals
+ */
+GLvoid
+srDraw(SRcontext* context, GLMindexed* indexed);
+
+/* srDelete: Stops the threads and deletes a SRcontext structure.
+ *
+ * context - structure created with srCreate()
+ */
+GLvoid
+srDelete(SRcontext* context);
+
+#endif
@@ -0,0 +1,393 @@
+/*
+      sequence.cpp
+
+      PCA weight tracks written by the model (model/__init__.py).
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sequence.h"
+#include "filter.h"
+
+
+/* sqReadFloats: read whitespace separated numbers from a file
+ *
+ * count - returns the number of values read
+ * returns a malloc'd array, or NULL if the file can't be opened
+ */
+static GLfloat*
+sqReadFloats(const char* filename, GLuint* count)
+{
+    FILE* file;
+    GLfloat* values;
+    GLfloat value;
+    GLuint size;
+
+    file = fopen(filename, "r");
+    if (!file) {
+        fprintf(stderr, "sqRead() failed: can't open \"%s\".\n", filename);
+        return NULL;
+    }
+
+    size = 1024;
+    values = (GLfloat*)malloc(sizeof(GLfloat) * size);
+    *count = 0;
+    while (fscanf(file, "%f", &value) == 1) {
+        if (*count == size) {
+            size *= 2;
+            values = (GLfloat*)realloc(values, sizeof(GLfloat) * size);
+        }
+        values[(*count)++] = value;
+    }
+    fclose(file);
+
+    return values;
+}
+
+/* sqMap: map a packed track file
+ *
+ * returns GL_FALSE if there is no such file, or it is malformed (the
+ * text tracks are read instead)
+ */
+static GLboolean
+sqMap(SQtracks* tracks, const char* filename)
+{
+    struct stat status;
+    GLubyte* mapping;
+    GLuint header[6];
+    GLfloat frametime;
+    int file;
+
+    file = open(filename, O_RDONLY);
+    if (file < 0)
+        return GL_FALSE;
+    if (fstat(file, &status) < 0 || status.st_size < SQ_HEADER) {
+        close(file);
+        return GL_FALSE;
+    }
+    mapping = (GLubyte*)mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapping == (GLubyte*)MAP_FAILED)
+        return GL_FALSE;
+
+    /* empty tracks or a bad frame time would make every reader fail */
+    memcpy(header, mapping, sizeof(header));
+    memcpy(&frametime, &header[2], sizeof(GLfloat));
+    if (memcmp(mapping, "SQTK", 4) || header[1] != SQ_VERSION ||
+        header[3] == 0 || header[4] == 0 || !(frametime > 0.0f) || isinf(frametime) ||
+        (size_t)status.st_size < SQ_HEADER + sizeof(GLfloat) * header[3] * header[4]) {
+        fprintf(stderr, "sqRead(): ignoring \"%s\", not a packed track file.\n", filename);
+        munmap(mapping, status.st_size);
+        return GL_FALSE;
+    }
+
+    tracks->frametime = frametime;
+    tracks->numtracks = header[3];
+    tracks->numframes = header[4];
+    tracks->flags = header[5];
+    tracks->frames = (GLfloat*)(mapping + SQ_HEADER);
+    tracks->mapping = mapping;
+    tracks->mapsize = status.st_size;
+    return GL_TRUE;
+}
+
+/* sqReadText: read the text tracks sequence0 to sequence15, cut to
+ * the shortest, into frame after frame order
+ *
+ * returns GL_FALSE if a file is missing or they hold no frame
+ */
+static GLboolean
+sqReadText(SQtracks* tracks, const char* dir)
+{
+    GLfloat* values[SQ_NUMTRACKS];
+    GLuint lengths[SQ_NUMTRACKS];
+    char filename[1024];
+    GLuint i, f;
+
+    for (i = 0; i < SQ_NUMTRACKS; i++) {
+        sprintf(filename, "%s/sequence%u", dir, i);
+        values[i] = sqReadFloats(filename, &lengths[i]);
+        if (!values[i]) {
+            while (i > 0)
+                free(values[--i]);
+            return GL_FALSE;
+        }
+        if (i == 0 || lengths[i] < tracks->numframes)
+            tracks->numframes = lengths[i];
+    }
+    if (tracks->numframes == 0) {
+        fprintf(stderr, "sqRead() failed: the text tracks hold no frame.\n");
+        for (i = 0; i < SQ_NUMTRACKS; i++)
+            free(values[i]);
+        return GL_FALSE;
+    }
+
+    tracks->numtracks = SQ_NUMTRACKS;
+    tracks->frametime = SQ_FRAMETIME;
+    tracks->flags = 0;
+    tracks->frames = (GLfloat*)malloc(sizeof(GLfloat) * SQ_NUMTRACKS * (tracks->numframes + 1));
+    for (i = 0; i < SQ_NUMTRACKS; i++) {
+        for (f = 0; f < tracks->numframes; f++)
+            tracks->frames[SQ_NUMTRACKS * f + i] = values[i][f];
+        free(values[i]);
+    }
+    return GL_TRUE;
+}
+
+
+/* public functions */
+
+
+/* sqRead: Reads the tracks and correspond_sequence from a directory.
+ *
+ * dir - directory holding the files ("." for the working directory)
+ */
+SQtracks*
+sqRead(const char* dir)
+{
+    SQtracks* tracks;
+    GLfloat* selected;
+    char filename[1024];
+    GLuint i;
+
+    assert(dir);
+
+    tracks = (SQtracks*)malloc(sizeof(SQtracks));
+    tracks->numtracks = 0;
+    tracks->numframes = 0;
+    tracks->frametime = SQ_FRAMETIME;
+    tracks->flags = 0;
+    tracks->frames = NULL;
+    tracks->mapping = NULL;
+    tracks->mapsize = 0;
+    tracks->numselected = 0;
+    tracks->selected = NULL;
+
+    sprintf(filename, "%s/sequence.bin", dir);
+    if (!sqMap(tracks, filename) && !sqReadText(tracks, dir)) {
+        sqDelete(tracks);
+        return NULL;
+    }
+
+    sprintf(filename, "%s/correspond_sequence", dir);
+    selected = sqReadFloats(filename, &tracks->numselected);
+    if (!selected) {
+        sqDelete(tracks);
+        return NULL;
+    }
+    tracks->selected = (GLuint*)malloc(sizeof(GLuint) * (tracks->numselected + 1));
+    for (i = 0; i < tracks->numselected; i++) {
+        if (selected[i] < 0 || selected[i] >= tracks->numtracks) {
+            fprintf(stderr, "sqRead() failed: no track %d in correspond_sequence.\n",
+                (int)selected[i]);
+            free(selected);
+            sqDelete(tracks);
+            return NULL;
+        }
+        tracks->selected[i] = (GLuint)selected[i];
+    }
+    free(selected);
+
+    return tracks;
+}
+
+/* sqWeights: Evaluates the basis weights of a frame.
+ *
+ * tracks  - structure created with sqRead()
+ * frame   - frame index, less than numframes
+ * gains   - array of numselected GLfloats
+ * weights - array of numselected GLfloats to write the weights to
+ */
+GLvoid
+sqWeights(SQtracks* tracks, GLuint frame, GLfloat* gains, GLfloat* weights)
+{
+    GLuint k;
+
+    assert(tracks);
+    assert(frame < tracks->numframes);
+
+    for (k = 0; k < tracks->numselected; k++)
+        weights[k] = gains[k] * tracks->frames[tracks->numtracks * frame + tracks->selected[k]];
+}
+
+/* sqWeightsAt: Evaluates the basis weights at any point of the
+ * tracks, with a Catmull-Rom spline through the frames.
+ *
+ * tracks  - structure created with sqRead()
+ * frame   - position in frames (time / frametime)
+ * gains   - array of numselected GLfloats
+ * weights - array of numselected GLfloats to write the weights to
+ */
+GLvoid
+sqWeightsAt(SQtracks* tracks, GLdouble frame, GLfloat* gains, GLfloat* weights)
+{
+    GLfloat* f0;
+    GLfloat* f1;
+    GLfloat* f2;
+    GLfloat* f3;
+    GLfloat p0, p1, p2, p3, t;
+    GLuint i, last, k, n;
+
+    assert(tracks);
+    assert(tracks->numframes > 0);
+
+    last = tracks->numframes - 1;
+    if (frame < 0.0)
+        frame = 0.0;
+    if (frame > last)
+        frame = last;
+    i = (GLuint)frame;
+    t = (GLfloat)(frame - i);
+
+    /* the four frames around the position */
+    n = tracks->numtracks;
+    f0 = &tracks->frames[n * (i > 0 ? i - 1 : 0)];
+    f1 = &tracks->frames[n * i];
+    f2 = &tracks->frames[n * (i + 1 < last ? i + 1 : last)];
+    f3 = &tracks->frames[n * (i + 2 < last ? i + 2 : last)];
+    for (k = 0; k < tracks->numselected; k++) {
+        p0 = f0[tracks->selected[k]];
+        p1 = f1[tracks->selected[k]];
+        p2 = f2[tracks->selected[k]];
+        p3 = f3[tracks->selected[k]];
+        weights[k] = gains[k] * 0.5f * (2.0f * p1 + t * ((p2 - p0) +
+            t * ((2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) +
+            t * (3.0f * (p1 - p2) + p3 - p0))));
+    }
+}
+
+/* sqRange: Finds the largest absolute value of each basis weight
+ * over all frames.
+ *
+ * tracks     - structure created with sqRead()
+ * gains      - array of numselected GLfloats
+ * maxweights - array of numselected GLfloats to write the ranges to
+ */
+GLvoid
+sqRange(SQtracks* tracks, GLfloat* gains, GLfloat* maxweights)
+{
+    GLuint k, f;
+    GLfloat value;
+
+    assert(tracks);
+
+    for (k = 0; k < tracks->numselected; k++) {
+        maxweights[k] = 0.0f;
+        for (f = 0; f < tracks->numframes; f++) {
+            value = fabs(gains[k] * tracks->frames[tracks->numtracks * f + tracks->selected[k]]);
+            if (value > maxweights[k])
+                maxweights[k] = value;
+        }
+    }
+}
+
+/* sqWrite: Writes the tracks in the packed format.
+ *
+ * tracks   - structure created with sqRead()
+ * filename - name of the file to write
+ */
+GLboolean
+sqWrite(SQtracks* tracks, const char* filename)
+{
+    FILE* file;
+    GLubyte header[SQ_HEADER];
+    GLuint fields[6];
+    size_t count;
+
+    assert(tracks);
+    assert(filename);
+
+    file = fopen(filename, "wb");
+    if (!file) {
+        fprintf(stderr, "sqWrite() failed: can't open \"%s\".\n", filename);
+        return GL_FALSE;
+    }
+
+    memset(header, 0, sizeof(header));
+    memcpy(fields, "SQTK", 4);
+    fields[1] = SQ_VERSION;
+    memcpy(&fields[2], &tracks->frametime, sizeof(GLfloat));
+    fields[3] = tracks->numtracks;
+    fields[4] = tracks->numframes;
+    fields[5] = tracks->flags;
+    memcpy(header, fields, sizeof(fields));
+
+    count = (size_t)tracks->numtracks * tracks->numframes;
+    if (fwrite(header, sizeof(header), 1, file) != 1 ||
+        fwrite(tracks->frames, sizeof(GLfloat), count, file) != count) {
+        fprintf(stderr, "sqWrite() failed: can't write \"%s\".\n", filename);
+        fclose(file);
+        return GL_FALSE;
+    }
+    return fclose(file) == 0;
+}
+
+/* sqFilter: Smooths raw tracks at their own frame rate.
+ *
+ * tracks - structure created with sqRead()
+ * spec   - description of the filter
+ */
+GLboolean
+sqFilter(SQtracks* tracks, const char* spec)
+{
+    FLfilter* filter;
+    GLfloat* frames;
+    GLuint size, f, n;
+
+    assert(tracks);
+    assert(spec);
+
+    if (!(tracks->flags & SQ_RAW) || !strcmp(spec, "none"))
+        return GL_TRUE;
+
+    /* one sample per frame; sqWeightsAt() interpolates between them,
+       so repeating the frames would only multiply the work */
+    filter = flParse(spec, tracks->numtracks, 1, tracks->frametime);
+    if (!filter)
+        return GL_FALSE;
+
+    /* at most flMaxSamples() more than one sample per frame */
+    size = tracks->numframes + flMaxSamples(filter);
+    frames = (GLfloat*)malloc(sizeof(GLfloat) * tracks->numtracks * (size + 1));
+    n = 0;
+    for (f = 0; f < tracks->numframes; f++)
+        n += flPush(filter, &tracks->frames[tracks->numtracks * f], &frames[tracks->numtracks * n]);
+    n += flFlush(filter, &frames[tracks->numtracks * n]);
+    flDelete(filter);
+
+    if (tracks->mapping) {
+        munmap(tracks->mapping, tracks->mapsize);
+        tracks->mapping = NULL;
+        tracks->mapsize = 0;
+    } else
+        free(tracks->frames);
+    tracks->frames = frames;
+    tracks->numframes = n;
+    tracks->flags &= ~SQ_RAW;
+    return GL_TRUE;
+}
+
+/* sqDelete: Deletes a SQtracks structure.
+ *
+ * tracks - structure created with sqRead()
+ */
+GLvoid
+sqDelete(SQtracks* tracks)
+{
+    assert(tracks);
+
+    if (tracks->mapping)
+        munmap(tracks->mapping, tracks->mapsize);
+    else if (tracks->frames)
+        free(tracks->frames);
+    if (tracks->selected)
+        free(tracks->selected);
+    free(tracks);
+}
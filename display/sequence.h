@@ -0,0 +1,144 @@
+/*
+      sequence.h
+
+      PCA weight tracks written by the model (model/__init__.py).
+
+      The model writes one track per PCA component, sequence0 to
+      sequence15, with one weight per frame, and correspond_sequence,
+      which lists the track that drives each component of the display
+      basis.
+
+      It also writes its predictions packed into sequence.bin, which
+      sqRead() prefers and maps instead of parsing.  The file is a 64
+      byte header followed by the weights frame after frame, so the 16
+      weights of a frame share one cache line:
+
+          offset  size
+               0     4  "SQTK"
+               4     4  version (SQ_VERSION)
+               8     4  milliseconds per frame (float)
+              12     4  number of tracks
+              16     4  number of frames
+              20     4  flags (SQ_RAW)
+              24    40  zero
+              64        numframes * numtracks floats
+
+      All fields are little endian.
+
+      The text tracks are smoothed and at SQ_FRAMETIME; the model packs
+      its raw predictions instead, one frame every SQ_MODELTIME ms and
+      flagged SQ_RAW, and sqFilter() smooths them at that rate with
+      the filters of filter.h, which also smooth live frames.  Either
+      way sqWeightsAt() interpolates between the frames.
+
+ */
+
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+
+#include <stddef.h>
+#include "glm.h"
+
+
+#define SQ_NUMTRACKS 16         /* number of sequence files */
+#define SQ_FRAMETIME 10         /* milliseconds per frame of the text tracks */
+#define SQ_AUDIOSTART 360       /* timeline (ms) at which the voice starts */
+#define SQ_VERSION 1            /* version of the packed format */
+#define SQ_HEADER 64            /* size of the packed header in bytes */
+#define SQ_MODELTIME 40         /* milliseconds per frame the model predicts */
+
+#define SQ_RAW 1                /* flag: frames are the unsmoothed predictions */
+
+
+/* SQtracks: Structure that defines a set of weight tracks.
+ */
+typedef struct _SQtracks {
+  GLuint   numtracks;           /* number of tracks */
+  GLuint   numframes;           /* number of frames */
+  GLfloat  frametime;           /* milliseconds per frame */
+  GLuint   flags;               /* SQ_RAW */
+  GLfloat* frames;              /* numtracks weights per frame, frame after frame */
+  GLvoid*  mapping;             /* the mapped file, or NULL if frames was read */
+  size_t   mapsize;             /* size of the mapping */
+
+  GLuint   numselected;         /* number of entries in correspond_sequence */
+  GLuint*  selected;            /* track driving each basis component */
+} SQtracks;
+
+
+/* sqRead: Reads the tracks and correspond_sequence from a directory,
+ * mapping sequence.bin if there is one, and parsing the text tracks
+ * (cut to the shortest) otherwise.  A sequence.bin without tracks or
+ * frames, or with a frame time that isn't positive, is ignored.
+ * Returns NULL if a file is missing or malformed or there is no frame,
+ * otherwise a pointer to the created structure which should be free'd
+ * with sqDelete().
+ *
+ * dir - directory holding the files ("." for the working directory)
+ */
+SQtracks*
+sqRead(const char* dir);
+
+/* sqWeights: Evaluates the basis weights of a frame:
+ *
+ *     weights[k] = gains[k] * frames[numtracks * frame + selected[k]]
+ *
+ * tracks  - structure created with sqRead()
+ * frame   - frame index, less than numframes
+ * gains   - array of numselected GLfloats
+ * weights - array of numselected GLfloats to write the weights to
+ */
+GLvoid
+sqWeights(SQtracks* tracks, GLuint frame, GLfloat* gains, GLfloat* weights);
+
+/* sqWeightsAt: Evaluates the basis weights at any point of the
+ * tracks, with a Catmull-Rom spline through the frames.  Whole frames
+ * give the same weights as sqWeights(); the ends are held.
+ *
+ * tracks  - structure created with sqRead()
+ * frame   - position in frames (time / frametime)
+ * gains   - array of numselected GLfloats
+ * weights - array of numselected GLfloats to write the weights to
+ */
+GLvoid
+sqWeightsAt(SQtracks* tracks, GLdouble frame, GLfloat* gains, GLfloat* weights);
+
+/* sqRange: Finds the largest absolute value of each basis weight
+ * over all frames.
+ *
+ * tracks     - structure created with sqRead()
+ * gains      - array of numselected GLfloats
+ * maxweights - array of numselected GLfloats to write the ranges to
+ */
+GLvoid
+sqRange(SQtracks* tracks, GLfloat* gains, GLfloat* maxweights);
+
+/* sqWrite: Writes the tracks in the packed format.  Returns GL_FALSE
+ * if the file can't be written.
+ *
+ * tracks   - structure created with sqRead()
+ * filename - name of the file to write
+ */
+GLboolean
+sqWrite(SQtracks* tracks, const char* filename);
+
+/* sqFilter: Smooths raw tracks at their own frame rate with a filter
+ * (see flParse()), or "none" to leave them as they are, mapped.  The
+ * frames stay one per input frame, frame after frame.  Tracks that are
+ * not raw are already smoothed and left alone.  Returns GL_FALSE if
+ * the filter is not valid.
+ *
+ * tracks - structure created with sqRead()
+ * spec   - description of the filter
+ */
+GLboolean
+sqFilter(SQtracks* tracks, const char* spec);
+
+/* sqDelete: Deletes a SQtracks structure.
+ *
+ * tracks - structure created with sqRead()
+ */
+GLvoid
+sqDelete(SQtracks* tracks);
+
+#endif
@@ -0,0 +1,187 @@
+// Headless animation server: advances many sessions (session.h) at a
+// fixed tick on a thread pool, while a client thread reads their
+// published frames, and reports the load.
+//
+//   ./display/server [-n sessions] [-t threads] [-r hz] [-d seconds] [-m] [-F filter]
+//
+//   -n sessions  sessions to run (default 1000), each starting at a
+//                different point of the clip and looping it
+//   -t threads   threads stepping them (default one per processor)
+//   -r hz        ticks per second (default 100, the rate of the
+//                tracks; 0 to step as fast as possible)
+//   -d seconds   how long to run (default 10)
+//   -m           publish deformed meshes, not only the weights
+//   -F filter    smoothing of raw packed tracks (see flParse(), default
+//                flat, the smoothing of the model, or none)
+//
+// Runs from the repository root like main, reading the sequence files
+// (and ./data/head.obj with -m). Needs no GL context.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <algorithm>
+
+#include "glm.h"
+#include "blend.h"
+#include "sequence.h"
+#include "session.h"
+#include "pca.h"
+
+using namespace std;
+
+// same gains as ref1..ref4 in main.cpp
+GLfloat gains[4] = { 5, 5, 14, -5 };
+
+double Seconds()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// the client: reads one session after another until told to stop
+SSserver *server;
+bool stop = false;
+unsigned long long reads = 0;
+
+void *Client(void *arg)
+{
+	GLfloat weights[4];
+	for (unsigned int i = 0; !__atomic_load_n(&stop, __ATOMIC_ACQUIRE); i++)
+	{
+		ssRead(server->sessions[i % server->numsessions], weights, NULL, NULL);
+		reads++;
+	}
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int numsessions = 1000, numthreads = 0;
+	double hz = 100, duration = 10;
+	bool meshes = false;
+	const char *filter_spec = "flat";
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-n") && i + 1 < argc)
+			numsessions = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+			numthreads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+			hz = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-d") && i + 1 < argc)
+			duration = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-m"))
+			meshes = true;
+		else if (!strcmp(argv[i], "-F") && i + 1 < argc)
+			filter_spec = argv[++i];
+		else
+		{
+			fprintf(stderr, "usage: %s [-n sessions] [-t threads] [-r hz] [-d seconds] [-m] [-F filter]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (numsessions == 0)
+	{
+		fputs("No sessions to run\n", stderr);
+		return 1;
+	}
+
+	SQtracks *tracks = sqRead(".");
+	if (!tracks)
+	{
+		fputs("Couldn't read the weight sequences\n", stderr);
+		return 1;
+	}
+	// the gains, the client's weights and the basis have 4 components
+	if (tracks->numselected != 4)
+	{
+		fprintf(stderr, "correspond_sequence selects %u tracks, not 4\n", tracks->numselected);
+		return 1;
+	}
+	if (!sqFilter(tracks, filter_spec))
+		return 1;
+
+	// one model shared by every session
+	GLMmodel *mesh = NULL;
+	BSbasis *basis = NULL;
+	if (meshes)
+	{
+		mesh = glmReadOBJ("./data/head.obj", NULL, GL_TRUE);
+		glmUnitize(mesh);
+		glmFacetNormals(mesh);
+		glmVertexNormals(mesh, 90.0);
+		basis = bsCreate(mesh->numvertices, mean_shape, 1.0 / 30);
+		bsAddComponent(basis, pca_str1);
+		bsAddComponent(basis, pca_str2);
+		bsAddComponent(basis, pca_str3);
+		bsAddComponent(basis, pca_str4);
+		bsNormalBasis(basis, mesh);
+	}
+
+	server = ssServer(numthreads);
+	double length = tracks->numframes * tracks->frametime;
+	for (unsigned int i = 0; i < numsessions; i++)
+	{
+		SSsession *session = ssCreate(server, basis, tracks, gains, GL_TRUE,
+			meshes ? SS_MESH : SS_WEIGHTS);
+		session->clock = length * i / numsessions;
+	}
+	fprintf(stderr, "%u sessions (%s) on %u threads, %g ticks per second\n", numsessions,
+		meshes ? "meshes" : "weights", server->numthreads, hz);
+
+	pthread_t client;
+	pthread_create(&client, NULL, Client, NULL);
+
+	// each tick is due at a fixed time from the start, so a late one
+	// is followed by shorter sleeps rather than a drift
+	double tick = hz > 0 ? 1.0 / hz : 0, start = Seconds(), elapsed = 0;
+	double longest = 0, busy = 0;
+	unsigned int steps = 0, late = 0;
+	while (elapsed < duration)
+	{
+		double step_start = Seconds();
+		ssStep(server, tick > 0 ? tick * 1000 : tracks->frametime);
+		double step_time = Seconds() - step_start;
+		busy += step_time;
+		longest = max(longest, step_time);
+		steps++;
+
+		elapsed = Seconds() - start;
+		if (tick > 0)
+		{
+			double wait = steps * tick - elapsed;
+			if (wait < 0)
+				late++;
+			else
+			{
+				struct timespec t = { (time_t)wait, (long)((wait - floor(wait)) * 1e9) };
+				nanosleep(&t, NULL);
+			}
+			elapsed = Seconds() - start;
+		}
+	}
+	__atomic_store_n(&stop, true, __ATOMIC_RELEASE);
+	pthread_join(client, NULL);
+
+	fprintf(stderr, "%u steps in %.3f s: %.1f session frames per second\n", steps, elapsed,
+		(double)steps * numsessions / elapsed);
+	fprintf(stderr, "step time: mean %.2f max %.2f ms", busy * 1e3 / steps, longest * 1e3);
+	if (tick > 0)
+		fprintf(stderr, " of a %.2f ms tick, %u late", tick * 1e3, late);
+	fprintf(stderr, "\n%llu frames read by the client\n", reads);
+
+	ssDelete(server);
+	if (basis)
+		bsDelete(basis);
+	if (mesh)
+		glmDelete(mesh);
+	sqDelete(tracks);
+
+	return 0;
+}
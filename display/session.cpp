@@ -0,0 +1,305 @@
+/*
+      session.cpp
+
+      Animation sessions advanced in parallel by a pool of threads.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sched.h>
+#include <unistd.h>
+#include "session.h"
+
+
+/* ssAdvance: advance a session's clock and publish its frame there */
+static GLvoid
+ssAdvance(SSsession* session, GLdouble elapsed)
+{
+    GLuint sequence, k;
+
+    session->clock += elapsed * session->rate;
+
+    /* readers retry while the sequence is odd or has moved on */
+    sequence = session->sequence;
+    __atomic_store_n(&session->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    session->time = session->clock;
+    for (k = 0; k < session->mixer->numcomponents; k++)
+        session->weights[k] = 0.0f;
+    mxMix(session->mixer, session->clock, session->weights);
+    if (session->output == SS_MESH) {
+        bsBlend(session->basis, session->weights, session->vertices);
+        bsBlendNormalArray(session->basis, session->weights, session->normals);
+    }
+
+    __atomic_store_n(&session->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+/* ssWork: advance chunks of sessions until none are left */
+static GLvoid
+ssWork(SSserver* server)
+{
+    GLuint first, last, i;
+
+    for (;;) {
+        first = __sync_fetch_and_add(&server->next, SS_CHUNK);
+        if (first >= server->numsessions)
+            break;
+        last = first + SS_CHUNK < server->numsessions ? first + SS_CHUNK : server->numsessions;
+        for (i = first; i < last; i++)
+            ssAdvance(server->sessions[i], server->elapsed);
+    }
+}
+
+/* ssWorker: thread function of the pool */
+static GLvoid*
+ssWorker(GLvoid* arg)
+{
+    SSserver* server;
+    GLuint seen;
+    GLboolean quit;
+
+    server = (SSserver*)arg;
+    seen = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&server->mutex);
+        while (server->generation == seen)
+            pthread_cond_wait(&server->start, &server->mutex);
+        seen = server->generation;
+        quit = server->quit;
+        pthread_mutex_unlock(&server->mutex);
+
+        if (quit)
+            break;
+        ssWork(server);
+
+        pthread_mutex_lock(&server->mutex);
+        if (--server->running == 0)
+            pthread_cond_signal(&server->done);
+        pthread_mutex_unlock(&server->mutex);
+    }
+
+    return NULL;
+}
+
+
+/* public functions */
+
+
+/* ssServer: Creates a server with no sessions and its thread pool.
+ *
+ * numthreads - threads to step with (0 for one per processor)
+ */
+SSserver*
+ssServer(GLuint numthreads)
+{
+    SSserver* server;
+    GLuint i;
+    long processors;
+
+    if (numthreads == 0) {
+        processors = sysconf(_SC_NPROCESSORS_ONLN);
+        numthreads = processors > 0 ? (GLuint)processors : 1;
+    }
+
+    server = (SSserver*)malloc(sizeof(SSserver));
+    server->numsessions = 0;
+    server->size = 0;
+    server->sessions = NULL;
+
+    server->numthreads = numthreads;
+    server->quit = GL_FALSE;
+    server->generation = 0;
+    server->running = 0;
+    server->next = 0;
+    server->elapsed = 0.0;
+    pthread_mutex_init(&server->mutex, NULL);
+    pthread_cond_init(&server->start, NULL);
+    pthread_cond_init(&server->done, NULL);
+    server->threads = (pthread_t*)malloc(sizeof(pthread_t) * numthreads);
+    for (i = 1; i < numthreads; i++)
+        pthread_create(&server->threads[i], NULL, ssWorker, server);
+
+    return server;
+}
+
+/* ssCreate: Adds a session playing weight tracks from its clock 0.
+ *
+ * server - structure created with ssServer()
+ * basis  - basis prepared with bsNormalBasis() with numselected
+ *          components (SS_MESH), or NULL (SS_WEIGHTS)
+ * tracks - tracks of the speech
+ * gains  - array of numselected GLfloats
+ * loop   - repeat the tracks instead of holding the end
+ * output - SS_WEIGHTS or SS_MESH
+ */
+SSsession*
+ssCreate(SSserver* server, BSbasis* basis, SQtracks* tracks, GLfloat* gains,
+         GLboolean loop, GLuint output)
+{
+    SSsession* session;
+
+    assert(server);
+    assert(tracks);
+    assert(output == SS_WEIGHTS || output == SS_MESH);
+    assert(output == SS_WEIGHTS || (basis && basis->normals &&
+        basis->numcomponents == tracks->numselected));
+
+    session = (SSsession*)malloc(sizeof(SSsession));
+    session->basis = basis;
+    session->mixer = mxCreate(tracks->numselected);
+    session->speech = mxAddTracks(session->mixer, tracks, gains, MX_ADD);
+    session->speech->loop = loop;
+    session->output = output;
+    session->clock = 0.0;
+    session->rate = 1.0;
+
+    session->sequence = 0;
+    session->time = 0.0;
+    session->weights = (GLfloat*)malloc(sizeof(GLfloat) * tracks->numselected);
+    session->vertices = session->normals = NULL;
+    if (output == SS_MESH) {
+        session->vertices = (GLfloat*)malloc(sizeof(GLfloat) * 3 * basis->numvertices);
+        session->normals = (GLfloat*)malloc(sizeof(GLfloat) * 3 * basis->numvertices);
+    }
+    ssAdvance(session, 0.0);
+
+    if (server->numsessions == server->size) {
+        server->size = server->size ? 2 * server->size : 64;
+        server->sessions = (SSsession**)realloc(server->sessions,
+            sizeof(SSsession*) * server->size);
+    }
+    server->sessions[server->numsessions++] = session;
+
+    return session;
+}
+
+/* ssRemove: Deletes a session of a server.
+ *
+ * server  - structure created with ssServer()
+ * session - session created with ssCreate()
+ */
+GLvoid
+ssRemove(SSserver* server, SSsession* session)
+{
+    GLuint i;
+
+    assert(server);
+    assert(session);
+
+    /* the order of the sessions doesn't matter */
+    for (i = 0; i < server->numsessions; i++)
+        if (server->sessions[i] == session)
+            break;
+    assert(i < server->numsessions);
+    server->sessions[i] = server->sessions[--server->numsessions];
+
+    mxDelete(session->mixer);
+    free(session->weights);
+    free(session->vertices);
+    free(session->normals);
+    free(session);
+}
+
+/* ssStep: Advances every session and publishes its frame.
+ *
+ * server  - structure created with ssServer()
+ * elapsed - ms to advance the clocks by (times each session's rate)
+ */
+GLvoid
+ssStep(SSserver* server, GLdouble elapsed)
+{
+    assert(server);
+
+    server->elapsed = elapsed;
+    server->next = 0;
+    if (server->numthreads == 1 || server->numsessions <= SS_CHUNK) {
+        ssWork(server);
+        return;
+    }
+
+    pthread_mutex_lock(&server->mutex);
+    server->running = server->numthreads - 1;
+    server->generation++;
+    pthread_cond_broadcast(&server->start);
+    pthread_mutex_unlock(&server->mutex);
+
+    ssWork(server);
+
+    pthread_mutex_lock(&server->mutex);
+    while (server->running > 0)
+        pthread_cond_wait(&server->done, &server->mutex);
+    pthread_mutex_unlock(&server->mutex);
+}
+
+/* ssRead: Copies the published frame of a session.
+ *
+ * session  - session created with ssCreate()
+ * weights  - array of numcomponents GLfloats, or NULL
+ * vertices - array of 3 * numvertices GLfloats (SS_MESH), or NULL
+ * normals  - array of 3 * numvertices GLfloats (SS_MESH), or NULL
+ */
+GLdouble
+ssRead(SSsession* session, GLfloat* weights, GLfloat* vertices, GLfloat* normals)
+{
+    GLuint sequence, size;
+    GLdouble time;
+
+    assert(session);
+    assert(session->output == SS_MESH || (!vertices && !normals));
+
+    size = session->basis ? 3 * session->basis->numvertices : 0;
+    for (;;) {
+        sequence = __atomic_load_n(&session->sequence, __ATOMIC_ACQUIRE);
+        if (sequence & 1) {
+            sched_yield();
+            continue;
+        }
+
+        time = session->time;
+        if (weights)
+            memcpy(weights, session->weights, sizeof(GLfloat) * session->mixer->numcomponents);
+        if (vertices)
+            memcpy(vertices, session->vertices, sizeof(GLfloat) * size);
+        if (normals)
+            memcpy(normals, session->normals, sizeof(GLfloat) * size);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&session->sequence, __ATOMIC_RELAXED) == sequence)
+            return time;
+    }
+}
+
+/* ssDelete: Stops the threads and deletes a SSserver structure and its
+ * sessions.
+ *
+ * server - structure created with ssServer()
+ */
+GLvoid
+ssDelete(SSserver* server)
+{
+    GLuint i;
+
+    assert(server);
+
+    pthread_mutex_lock(&server->mutex);
+    server->quit = GL_TRUE;
+    server->generation++;
+    pthread_cond_broadcast(&server->start);
+    pthread_mutex_unlock(&server->mutex);
+    for (i = 1; i < server->numthreads; i++)
+        pthread_join(server->threads[i], NULL);
+
+    pthread_mutex_destroy(&server->mutex);
+    pthread_cond_destroy(&server->start);
+    pthread_cond_destroy(&server->done);
+    while (server->numsessions > 0)
+        ssRemove(server, server->sessions[server->numsessions - 1]);
+    free(server->sessions);
+    free(server->threads);
+    free(server);
+}
@@ -0,0 +1,140 @@
+/*
+      session.h
+
+      Animation sessions advanced in parallel by a pool of threads.
+
+      A session is one avatar: its own clock, a mixer (mixer.h) whose
+      bottom layer plays its weight tracks, and the basis of its model.
+      Tracks and bases are only read, so any number of sessions can
+      share one sequence.bin mapping or one model.  ssStep() advances
+      every session of a server by the same elapsed time (scaled by
+      each session's rate) on the server's threads, which take the
+      sessions in chunks, and publishes each session's weights and,
+      for SS_MESH sessions, its deformed vertices and normals (as
+      bsBlend() and bsBlendNormalArray() write them, not unitized).
+
+      Publishing is a sequence lock: ssRead() may be called from any
+      thread at any time and copies a consistent frame, retrying if the
+      session was republished during the copy.  Sessions are created
+      and deleted by the thread that calls ssStep(), between steps, and
+      a session must no longer be read once it is deleted.
+
+ */
+
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <pthread.h>
+#include "glm.h"
+#include "blend.h"
+#include "sequence.h"
+#include "mixer.h"
+
+
+#define SS_WEIGHTS 0            /* output: the weights */
+#define SS_MESH 1               /* output: the weights and the deformed mesh */
+
+#define SS_CHUNK 16             /* sessions a thread takes at a time */
+
+
+/* SSsession: Structure that defines a session.
+ */
+typedef struct _SSsession {
+  BSbasis* basis;               /* basis of the model, NULL for SS_WEIGHTS */
+  MXmixer* mixer;               /* layers, the speech at the bottom */
+  MXlayer* speech;              /* layer playing the tracks */
+  GLuint   output;              /* SS_WEIGHTS or SS_MESH */
+  GLdouble clock;               /* session time, ms */
+  GLdouble rate;                /* session ms per ms of ssStep(), 0 to hold */
+
+  GLuint   sequence;            /* even when published, odd while publishing */
+  GLdouble time;                /* clock of the published frame */
+  GLfloat* weights;             /* published weights */
+  GLfloat* vertices;            /* published vertices (3 per basis vertex) */
+  GLfloat* normals;             /* published normals (3 per basis vertex) */
+} SSsession;
+
+/* SSserver: Structure that defines a set of sessions and the threads
+ * that advance them.
+ */
+typedef struct _SSserver {
+  GLuint   numsessions;         /* number of sessions */
+  GLuint   size;                /* allocated size of sessions */
+  SSsession** sessions;         /* the sessions */
+
+  GLuint   numthreads;          /* threads stepping, including the caller */
+  pthread_t* threads;           /* worker threads */
+  pthread_mutex_t mutex;        /* guards the fields below */
+  pthread_cond_t  start;        /* signalled when a step starts */
+  pthread_cond_t  done;         /* signalled when the last worker is done */
+  GLboolean quit;               /* set to stop the workers */
+  GLuint   generation;          /* incremented for every step */
+  GLuint   running;             /* workers still running the step */
+  volatile GLuint next;         /* next session to take in the step */
+  GLdouble elapsed;             /* ms the step advances by */
+} SSserver;
+
+
+/* ssServer: Creates a server with no sessions and its thread pool.
+ * Returns a pointer to the created structure which should be free'd
+ * with ssDelete().
+ *
+ * numthreads - threads to step with (0 for one per processor)
+ */
+SSserver*
+ssServer(GLuint numthreads);
+
+/* ssCreate: Adds a session playing weight tracks from its clock 0,
+ * repeating them if loop is set, and publishes its first frame.  More
+ * layers can be added to its mixer.  Returns the session, owned by
+ * the server.
+ *
+ * server - structure created with ssServer()
+ * basis  - basis prepared with bsNormalBasis() with numselected
+ *          components (SS_MESH), or NULL (SS_WEIGHTS)
+ * tracks - tracks of the speech
+ * gains  - array of numselected GLfloats
+ * loop   - repeat the tracks instead of holding the end
+ * output - SS_WEIGHTS or SS_MESH
+ */
+SSsession*
+ssCreate(SSserver* server, BSbasis* basis, SQtracks* tracks, GLfloat* gains,
+         GLboolean loop, GLuint output);
+
+/* ssRemove: Deletes a session of a server.
+ *
+ * server  - structure created with ssServer()
+ * session - session created with ssCreate()
+ */
+GLvoid
+ssRemove(SSserver* server, SSsession* session);
+
+/* ssStep: Advances every session and publishes its frame, on the
+ * server's threads, and returns when all are published.
+ *
+ * server  - structure created with ssServer()
+ * elapsed - ms to advance the clocks by (times each session's rate)
+ */
+GLvoid
+ssStep(SSserver* server, GLdouble elapsed);
+
+/* ssRead: Copies the published frame of a session.  Safe from any
+ * thread, during ssStep() too.  Returns the clock of the frame.
+ *
+ * session  - session created with ssCreate()
+ * weights  - array of numcomponents GLfloats, or NULL
+ * vertices - array of 3 * numvertices GLfloats (SS_MESH), or NULL
+ * normals  - array of 3 * numvertices GLfloats (SS_MESH), or NULL
+ */
+GLdouble
+ssRead(SSsession* session, GLfloat* weights, GLfloat* vertices, GLfloat* normals);
+
+/* ssDelete: Stops the threads and deletes a SSserver structure and its
+ * sessions.
+ *
+ * server - structure created with ssServer()
+ */
+GLvoid
+ssDelete(SSserver* server);
+
+#endif
@@ -0,0 +1,274 @@
+/*
+      split.cpp
+
+      Static/dynamic split of a blendshape model.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "split.h"
+
+
+#define T(x) (model->triangles[(x)])
+
+
+/* spLength: length of a 3 vector */
+static GLfloat
+spLength(GLfloat* v)
+{
+    return (GLfloat)sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+}
+
+/* spWithin: whether the offset sum(weights[k] * deltas[k]) of a vertex
+ * stays within a length for every set of weights (stopping at the
+ * first that does not, which for most moving vertices is one of the
+ * first frames)
+ *
+ * vertex     - basis vertex
+ * numweights - number of sets of numcomponents weights
+ */
+static GLboolean
+spWithin(BSbasis* basis, GLfloat** deltas, GLuint vertex, GLuint numweights,
+         GLfloat* weights, GLfloat limit)
+{
+    GLfloat offset[3];
+    GLuint s, j, k;
+
+    if (limit < 0.0f)
+        return GL_FALSE;
+    for (s = 0; s < numweights; s++, weights += basis->numcomponents) {
+        for (j = 0; j < 3; j++) {
+            offset[j] = 0.0f;
+            for (k = 0; k < basis->numcomponents; k++)
+                offset[j] += weights[k] * deltas[k][3 * vertex + j];
+        }
+        if (spLength(offset) > limit)
+            return GL_FALSE;
+    }
+    return GL_TRUE;
+}
+
+
+/* public functions */
+
+
+/* spCreate: Splits a model and uploads the static part.
+ *
+ * basis      - basis prepared with bsNormalBasis()
+ * model      - the model the basis animates
+ * tracks     - tracks the model is animated with
+ * gains      - array of numcomponents GLfloats, the gains of the tracks
+ * maxweights - bound of the absolute value of each weight other
+ *              layers add to the tracks (such as the amplitudes of a
+ *              sine layer), or NULL
+ * tolerance  - largest displacement of a static vertex, in the units
+ *              of the blended model
+ * angle      - largest normal change of a static vertex, in degrees
+ */
+SPmesh*
+spCreate(BSbasis* basis, GLMmodel* model, SQtracks* tracks, GLfloat* gains,
+         GLfloat* maxweights, GLfloat tolerance, GLfloat angle)
+{
+    SPmesh* mesh;
+    GLuint* slots;
+    GLuint* indices;
+    GLfloat* data;
+    GLfloat* p;
+    GLfloat* weights;
+    GLfloat zeros[BS_MAX_COMPONENTS];
+    GLfloat displacement, change, sine, length;
+    GLuint i, j, k, numweights, numstatic, numdynamic;
+    GLboolean isstatic;
+
+    assert(basis);
+    assert(basis->normals);
+    assert(model);
+    assert(model->numvertices == basis->numvertices);
+    assert(tracks);
+    assert(tracks->numselected == basis->numcomponents);
+    assert(gains);
+
+    mesh = (SPmesh*)malloc(sizeof(SPmesh));
+    mesh->basis = basis;
+    mesh->numvertices = basis->numvertices;
+
+    /* the weights of every frame and halfway to the next, as the
+       spline of sqWeightsAt() can overshoot the frames between them */
+    numweights = tracks->numframes > 0 ? 2 * tracks->numframes - 1 : 0;
+    weights = (GLfloat*)malloc(sizeof(GLfloat) * basis->numcomponents * (numweights + 1));
+    for (i = 0; i < numweights; i++)
+        sqWeightsAt(tracks, i / 2.0, gains, &weights[basis->numcomponents * i]);
+
+    /* classify by the offset at every one of them, plus a bound of
+       what the other layers add, giving static vertices the first
+       slots */
+    sine = (GLfloat)sin(angle * M_PI / 180.0);
+    slots = (GLuint*)malloc(sizeof(GLuint) * basis->numvertices);
+    mesh->dynamic = (GLuint*)malloc(sizeof(GLuint) * basis->numvertices);
+    numstatic = numdynamic = 0;
+    for (i = 0; i < basis->numvertices; i++) {
+        displacement = change = 0.0f;
+        for (k = 0; maxweights && k < basis->numcomponents; k++) {
+            displacement += fabs(maxweights[k]) * spLength(&basis->components[k][3 * i]);
+            change += fabs(maxweights[k]) * spLength(&basis->normaldeltas[k][3 * i]);
+        }
+        length = spLength(&basis->normals[3 * i]);
+        isstatic =
+            spWithin(basis, basis->components, i, numweights, weights,
+                     tolerance / basis->scale - displacement) &&
+            spWithin(basis, basis->normaldeltas, i, numweights, weights,
+                     length * sine - change);
+        if (isstatic)
+            slots[i] = numstatic++;
+        else
+            mesh->dynamic[numdynamic++] = i;
+    }
+    for (k = 0; k < numdynamic; k++)
+        slots[mesh->dynamic[k]] = numstatic + k;
+    mesh->numstatic = numstatic;
+    mesh->numdynamic = numdynamic;
+    mesh->stream = (GLfloat*)malloc(sizeof(GLfloat) * 6 * (numdynamic + 1));
+
+    /* mean shape for every vertex */
+    data = (GLfloat*)malloc(sizeof(GLfloat) * 6 * basis->numvertices);
+    for (i = 0; i < basis->numvertices; i++) {
+        p = &data[6 * slots[i]];
+        length = spLength(&basis->normals[3 * i]);
+        for (j = 0; j < 3; j++) {
+            p[j] = basis->scale * basis->mean[3 * i + j] - basis->center[j];
+            p[3 + j] = length > 0.0f ? basis->normals[3 * i + j] / length : 0.0f;
+        }
+    }
+
+    /* bsNormalBasis() made nindices == vindices, so a vertex is a slot */
+    mesh->numindices = 3 * model->numtriangles;
+    indices = (GLuint*)malloc(sizeof(GLuint) * (mesh->numindices + 1));
+    for (i = 0; i < model->numtriangles; i++) {
+        for (j = 0; j < 3; j++) {
+            assert(T(i).nindices[j] == T(i).vindices[j]);
+            indices[3 * i + j] = slots[T(i).vindices[j] - 1];
+        }
+    }
+
+    glGenBuffers(1, &mesh->vertexbuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexbuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 6 * basis->numvertices, data, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glGenBuffers(1, &mesh->indexbuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexbuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * mesh->numindices, indices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    free(data);
+    free(indices);
+    free(slots);
+    free(weights);
+
+    for (k = 0; k < BS_MAX_COMPONENTS; k++)
+        zeros[k] = 0.0f;
+    spUpdate(mesh, zeros);
+
+    return mesh;
+}
+
+/* spUpdate: Blends the dynamic vertices for a set of weights and
+ * streams them to GL.
+ *
+ * mesh    - structure created with spCreate()
+ * weights - array of numcomponents GLfloats
+ */
+GLvoid
+spUpdate(SPmesh* mesh, GLfloat* weights)
+{
+    BSbasis* basis;
+    GLfloat length;
+    GLfloat* p;
+    GLuint i, j, k, v;
+
+    assert(mesh);
+    assert(weights);
+
+    basis = mesh->basis;
+
+    for (i = 0; i < mesh->numdynamic; i++) {
+        v = mesh->dynamic[i];
+        p = &mesh->stream[6 * i];
+        for (j = 0; j < 3; j++) {
+            p[j] = basis->mean[3 * v + j];
+            p[3 + j] = basis->normals[3 * v + j];
+            for (k = 0; k < basis->numcomponents; k++) {
+                p[j] += weights[k] * basis->components[k][3 * v + j];
+                p[3 + j] += weights[k] * basis->normaldeltas[k][3 * v + j];
+            }
+            p[j] = basis->scale * p[j] - basis->center[j];
+        }
+        length = spLength(&p[3]);
+        if (length > 0.0f) {
+            p[3] /= length;
+            p[4] /= length;
+            p[5] /= length;
+        }
+    }
+    spUpload(mesh);
+}
+
+/* spUpload: Streams the dynamic vertices to GL as they are in the
+ * stream array.
+ *
+ * mesh - structure created with spCreate()
+ */
+GLvoid
+spUpload(SPmesh* mesh)
+{
+    assert(mesh);
+
+    if (mesh->numdynamic == 0)
+        return;
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexbuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 6 * mesh->numstatic,
+        sizeof(GLfloat) * 6 * mesh->numdynamic, mesh->stream);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/* spDraw: Renders the model as of the last spUpdate().
+ *
+ * mesh - structure created with spCreate()
+ */
+GLvoid
+spDraw(SPmesh* mesh)
+{
+    assert(mesh);
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexbuffer);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(GLfloat) * 6, (GLvoid*)0);
+    glNormalPointer(GL_FLOAT, sizeof(GLfloat) * 6, (GLvoid*)(sizeof(GLfloat) * 3));
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexbuffer);
+    glDrawElements(GL_TRIANGLES, mesh->numindices, GL_UNSIGNED_INT, (GLvoid*)0);
+
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/* spDelete: Deletes a SPmesh structure and its GL buffers.
+ *
+ * mesh - structure created with spCreate()
+ */
+GLvoid
+spDelete(SPmesh* mesh)
+{
+    assert(mesh);
+
+    glDeleteBuffers(1, &mesh->vertexbuffer);
+    glDeleteBuffers(1, &mesh->indexbuffer);
+    free(mesh->dynamic);
+    free(mesh->stream);
+    free(mesh);
+}
@@ -0,0 +1,102 @@
+/*
+      split.h
+
+      Static/dynamic split of a blendshape model, so that only the
+      moving region is streamed to GL every frame.
+
+      A vertex is static when, at every frame of the tracks that
+      animate it (and halfway between frames), its blended position
+      stays within a distance tolerance of the mean shape and its
+      normal within an angle tolerance.  Motion mixed on top of the
+      tracks counts by a bound of its weights, so a layer that is faded
+      out should be left out and the split rebuilt when it fades in.
+      Static
+      vertices are frozen at the mean shape.  All vertices share one
+      buffer, static ones first, so triangles that straddle the two
+      parts need no duplicated vertices and cannot crack; per frame
+      only the dynamic range of the buffer is rewritten.
+
+      Unitizing every frame would move every vertex, so the basis is
+      unitized once with bsUnitize() and the blends are drawn as they
+      are.
+
+ */
+
+#ifndef SPLIT_H
+#define SPLIT_H
+
+#include "glm.h"
+#include "blend.h"
+#include "sequence.h"
+
+
+/* SPmesh: Structure that defines a split model.
+ */
+typedef struct _SPmesh {
+  BSbasis* basis;               /* basis the model is blended from */
+  GLuint   numvertices;         /* number of vertices */
+  GLuint   numstatic;           /* vertices frozen at the mean shape */
+  GLuint   numdynamic;          /* vertices blended every frame */
+  GLuint*  dynamic;             /* basis vertex of each dynamic vertex */
+  GLfloat* stream;              /* position and normal of each dynamic vertex */
+
+  GLuint   numindices;          /* number of indices (3 per triangle) */
+  GLuint   vertexbuffer;        /* interleaved positions and normals */
+  GLuint   indexbuffer;         /* static element array buffer */
+} SPmesh;
+
+
+/* spCreate: Splits a model and uploads the static part.  The model
+ * must have been prepared with bsNormalBasis() (one normal per
+ * vertex).  Requires a current GL context.  Returns a pointer to the
+ * created structure which should be free'd with spDelete().
+ *
+ * basis      - basis prepared with bsNormalBasis()
+ * model      - the model the basis animates
+ * tracks     - tracks the model is animated with
+ * gains      - array of numcomponents GLfloats, the gains of the tracks
+ * maxweights - bound of the absolute value of each weight other
+ *              layers add to the tracks (such as the amplitudes of a
+ *              sine layer), or NULL
+ * tolerance  - largest displacement of a static vertex, in the units
+ *              of the blended model (of the unitized model after
+ *              bsUnitize())
+ * angle      - largest normal change of a static vertex, in degrees
+ */
+SPmesh*
+spCreate(BSbasis* basis, GLMmodel* model, SQtracks* tracks, GLfloat* gains,
+         GLfloat* maxweights, GLfloat tolerance, GLfloat angle);
+
+/* spUpdate: Blends the dynamic vertices for a set of weights and
+ * streams them to GL.
+ *
+ * mesh    - structure created with spCreate()
+ * weights - array of numcomponents GLfloats
+ */
+GLvoid
+spUpdate(SPmesh* mesh, GLfloat* weights);
+
+/* spUpload: Streams the dynamic vertices to GL as they are in the
+ * stream array, for a frame put back there instead of blended by
+ * spUpdate().
+ *
+ * mesh - structure created with spCreate()
+ */
+GLvoid
+spUpload(SPmesh* mesh);
+
+/* spDraw: Renders the model as of the last spUpdate().
+ *
+ * mesh - structure created with spCreate()
+ */
+GLvoid
+spDraw(SPmesh* mesh);
+
+/* spDelete: Deletes a SPmesh structure and its GL buffers.
+ *
+ * mesh - structure created with spCreate()
+ */
+GLvoid
+spDelete(SPmesh* mesh);
+
+#endif
@@ -6,32 +6,41 @@
  *
  *  Usage:
  *
- *  o  call tbInit() in before any other tb call
+ *  All the state of a trackball is in a TBtrackball, so each view
+ *  can have its own and nothing is shared between them, not even a
+ *  GLUT idle callback.  The rotation is computed without GL, so only
+ *  tbMatrix() needs a current context.  Reading the matrix changes
+ *  nothing, so a frame can read it any number of times.
+ *
+ *  o  call tbInit() on a trackball before any other tb call
  *  o  call tbReshape() from the reshape callback
  *  o  call tbMatrix() to get the trackball matrix rotation
- *  o  call tbStartMotion() to begin trackball movememt
- *  o  call tbStopMotion() to stop trackball movememt
+ *  o  call tbMouse() from the mouse callback to start and stop
+ *     trackball movement
  *  o  call tbMotion() from the motion callback
  *  o  call tbAnimate(GL_TRUE) if you want the trackball to continue
- *     spinning after the mouse button has been released
+ *     spinning after the mouse button has been released, and
+ *     tbStep() once per frame (from an idle callback, say) to spin it
  *  o  call tbAnimate(GL_FALSE) if you want the trackball to stop
  *     spinning after the mouse button has been released
  *
  *  Typical setup:
  *
  *
+	TBtrackball trackball;
+
 	void
 	init(void)
 	{
-	  tbInit(GLUT_MIDDLE_BUTTON);
-	  tbAnimate(GL_TRUE);
+	  tbInit(&trackball, GLUT_MIDDLE_BUTTON);
+	  tbAnimate(&trackball, GL_TRUE);
 	  . . .
 	}
 
 	void
 	reshape(int width, int height)
 	{
-	  tbReshape(width, height);
+	  tbReshape(&trackball, width, height);
 	  . . .
 	}
 
@@ -40,7 +49,7 @@
 	{
 	  glPushMatrix();
 
-	  tbMatrix();
+	  tbMatrix(&trackball);
 	  . . . draw the scene . . .
 
 	  glPopMatrix();
@@ -49,14 +58,22 @@
 	void
 	mouse(int button, int state, int x, int y)
 	{
-	  tbMouse(button, state, x, y);
+	  tbMouse(&trackball, button, state, x, y);
 	  . . .
 	}
 
 	void
 	motion(int x, int y)
 	{
-	  tbMotion(x, y);
+	  tbMotion(&trackball, x, y);
+	  . . .
+	}
+
+	void
+	idle(void)
+	{
+	  if (tbStep(&trackball))
+	    glutPostRedisplay();
 	  . . .
 	}
 
@@ -69,9 +86,9 @@
 	  glutDisplayFunc(display);
 	  glutMouseFunc(mouse);
 	  glutMotionFunc(motion);
+	  glutIdleFunc(idle);
 	  . . .
 	}
- *
  * */
 
  /* includes */
@@ -82,22 +99,6 @@
 #include "trackball.h"
 
 
-/* globals */
-static GLuint    tb_lasttime;
-static GLfloat   tb_lastposition[3];
-
-static GLfloat   tb_angle = 0.0;
-static GLfloat   tb_axis[3];
-static GLfloat   tb_transform[4][4];
-
-static GLuint    tb_width;
-static GLuint    tb_height;
-
-static GLint     tb_button = -1;
-static GLboolean tb_tracking = GL_FALSE;
-static GLboolean tb_animate = GL_TRUE;
-
-
 /* functions */
 static void _tbPointToVector(int x, int y, int width, int height, float v[3])
 {
@@ -114,128 +115,157 @@ static void _tbPointToVector(int x, int y, int width, int height, float v[3])
 	v[2] *= a;
 }
 
-static void _tbAnimate(void)
+/* apply the rotation to the transform, as glRotatef() followed by
+   glMultMatrixf() of the transform would, without touching GL */
+static void _tbRotate(TBtrackball *tb)
 {
-	glutPostRedisplay();
+	float r[16], m[16], length, x, y, z, c, s, t;
+	float *transform = (float *)tb->transform;
+	int i, j, k;
+
+	length = sqrt(tb->axis[0] * tb->axis[0] + tb->axis[1] * tb->axis[1] +
+		tb->axis[2] * tb->axis[2]);
+	if (tb->angle == 0.0 || length == 0.0)
+		return;
+	x = tb->axis[0] / length;
+	y = tb->axis[1] / length;
+	z = tb->axis[2] / length;
+	c = cos(tb->angle * 3.14159265 / 180.0);
+	s = sin(tb->angle * 3.14159265 / 180.0);
+	t = 1.0 - c;
+
+	r[0] = x * x * t + c;     r[4] = x * y * t - z * s; r[8] = x * z * t + y * s;  r[12] = 0.0;
+	r[1] = y * x * t + z * s; r[5] = y * y * t + c;     r[9] = y * z * t - x * s;  r[13] = 0.0;
+	r[2] = x * z * t - y * s; r[6] = y * z * t + x * s; r[10] = z * z * t + c;    r[14] = 0.0;
+	r[3] = 0.0;               r[7] = 0.0;               r[11] = 0.0;              r[15] = 1.0;
+
+	for (j = 0; j < 4; j++)
+		for (i = 0; i < 4; i++) {
+			m[4 * j + i] = 0.0;
+			for (k = 0; k < 4; k++)
+				m[4 * j + i] += r[4 * k + i] * transform[4 * j + k];
+		}
+	memcpy(transform, m, sizeof(m));
 }
 
-void _tbStartMotion(int x, int y, int button, int time)
+static void _tbStartMotion(TBtrackball *tb, int x, int y, int button, int time)
 {
-	assert(tb_button != -1);
+	assert(tb->button != -1);
 
-	tb_tracking = GL_TRUE;
-	tb_lasttime = time;
-	_tbPointToVector(x, y, tb_width, tb_height, tb_lastposition);
+	tb->tracking = GL_TRUE;
+	tb->spinning = GL_FALSE;
+	tb->lasttime = time;
+	_tbPointToVector(x, y, tb->width, tb->height, tb->lastposition);
 }
 
-void _tbStopMotion(int button, unsigned time)
+static void _tbStopMotion(TBtrackball *tb, int button, unsigned time)
 {
-	assert(tb_button != -1);
+	assert(tb->button != -1);
 
-	tb_tracking = GL_FALSE;
+	tb->tracking = GL_FALSE;
 
-	if (time == tb_lasttime && tb_animate) {
-		glutIdleFunc(_tbAnimate);
-	}
-	else {
-		tb_angle = 0.0;
-		if (tb_animate)
-			glutIdleFunc(0);
-	}
+	/* released while still moving: tbStep() repeats the last motion */
+	if (time == tb->lasttime && tb->animate)
+		tb->spinning = GL_TRUE;
+	else
+		tb->angle = 0.0;
 }
 
-void tbAnimate(GLboolean animate)
+void tbAnimate(TBtrackball *tb, GLboolean animate)
 {
-	tb_animate = animate;
+	tb->animate = animate;
+	if (!animate)
+		tb->spinning = GL_FALSE;
 }
 
-void tbInit(GLuint button)
+GLboolean tbStep(TBtrackball *tb)
 {
-	tb_button = button;
-	tb_angle = 0.0;
+	assert(tb->button != -1);
 
-	/* put the identity in the trackball transform */
-	glPushMatrix();
-	glLoadIdentity();
-	glGetFloatv(GL_MODELVIEW_MATRIX, (GLfloat *)tb_transform);
-	glPopMatrix();
+	if (!tb->spinning)
+		return GL_FALSE;
+	_tbRotate(tb);
+	return GL_TRUE;
 }
 
-void tbMatrix()
+void tbInit(TBtrackball *tb, GLuint button)
 {
-	assert(tb_button != -1);
+	memset(tb, 0, sizeof(TBtrackball));
+	tb->button = button;
+	tb->angle = 0.0;
+	tb->tracking = GL_FALSE;
+	tb->animate = GL_TRUE;
+	tb->spinning = GL_FALSE;
+
+	/* put the identity in the trackball transform */
+	tb->transform[0][0] = tb->transform[1][1] = 1.0;
+	tb->transform[2][2] = tb->transform[3][3] = 1.0;
+}
 
-	glPushMatrix();
-	glLoadIdentity();
-	glRotatef(tb_angle, tb_axis[0], tb_axis[1], tb_axis[2]);
-	glMultMatrixf((GLfloat *)tb_transform);
-	glGetFloatv(GL_MODELVIEW_MATRIX, (GLfloat *)tb_transform);
-	glPopMatrix();
+void tbMatrix(TBtrackball *tb)
+{
+	assert(tb->button != -1);
 
-	glMultMatrixf((GLfloat *)tb_transform);
+	glMultMatrixf((GLfloat *)tb->transform);
 }
 
-void gettbMatrix(float *m)
+void gettbMatrix(TBtrackball *tb, float *m)
 {
-	glPushMatrix();
-	glLoadIdentity();
-	glRotatef(tb_angle, tb_axis[0], tb_axis[1], tb_axis[2]);
-	glMultMatrixf((GLfloat *)tb_transform);
-	glGetFloatv(GL_MODELVIEW_MATRIX, (GLfloat *)tb_transform);
-	glPopMatrix();
-
-	memcpy(m, tb_transform, 16 * sizeof(float));
+	memcpy(m, tb->transform, 16 * sizeof(float));
 }
 
-void tbReshape(int width, int height)
+void tbReshape(TBtrackball *tb, int width, int height)
 {
-	assert(tb_button != -1);
+	assert(tb->button != -1);
 
-	tb_width = width;
-	tb_height = height;
+	tb->width = width;
+	tb->height = height;
 }
 
-void tbMouse(int button, int state, int x, int y)
+void tbMouse(TBtrackball *tb, int button, int state, int x, int y)
 {
-	assert(tb_button != -1);
+	assert(tb->button != -1);
 
-	if (state == GLUT_DOWN && button == tb_button)
-		_tbStartMotion(x, y, button, glutGet(GLUT_ELAPSED_TIME));
-	else if (state == GLUT_UP && button == tb_button)
-		_tbStopMotion(button, glutGet(GLUT_ELAPSED_TIME));
+	if (state == GLUT_DOWN && button == tb->button)
+		_tbStartMotion(tb, x, y, button, glutGet(GLUT_ELAPSED_TIME));
+	else if (state == GLUT_UP && button == tb->button)
+		_tbStopMotion(tb, button, glutGet(GLUT_ELAPSED_TIME));
 }
 
-void tbMotion(int x, int y)
+void tbMotion(TBtrackball *tb, int x, int y)
 {
 	GLfloat current_position[3], dx, dy, dz;
 
-	assert(tb_button != -1);
+	assert(tb->button != -1);
 
-	if (tb_tracking == GL_FALSE)
+	if (tb->tracking == GL_FALSE)
 		return;
 
-	_tbPointToVector(x, y, tb_width, tb_height, current_position);
+	_tbPointToVector(x, y, tb->width, tb->height, current_position);
 
 	/* calculate the angle to rotate by (directly proportional to the
 	   length of the mouse movement */
-	dx = current_position[0] - tb_lastposition[0];
-	dy = current_position[1] - tb_lastposition[1];
-	dz = current_position[2] - tb_lastposition[2];
-	tb_angle = 90.0 * sqrt(dx * dx + dy * dy + dz * dz);
+	dx = current_position[0] - tb->lastposition[0];
+	dy = current_position[1] - tb->lastposition[1];
+	dz = current_position[2] - tb->lastposition[2];
+	tb->angle = 90.0 * sqrt(dx * dx + dy * dy + dz * dz);
 
 	/* calculate the axis of rotation (cross product) */
-	tb_axis[0] = tb_lastposition[1] * current_position[2] -
-		tb_lastposition[2] * current_position[1];
-	tb_axis[1] = tb_lastposition[2] * current_position[0] -
-		tb_lastposition[0] * current_position[2];
-	tb_axis[2] = tb_lastposition[0] * current_position[1] -
-		tb_lastposition[1] * current_position[0];
+	tb->axis[0] = tb->lastposition[1] * current_position[2] -
+		tb->lastposition[2] * current_position[1];
+	tb->axis[1] = tb->lastposition[2] * current_position[0] -
+		tb->lastposition[0] * current_position[2];
+	tb->axis[2] = tb->lastposition[0] * current_position[1] -
+		tb->lastposition[1] * current_position[0];
 
 	/* reset for next time */
-	tb_lasttime = glutGet(GLUT_ELAPSED_TIME);
-	tb_lastposition[0] = current_position[0];
-	tb_lastposition[1] = current_position[1];
-	tb_lastposition[2] = current_position[2];
+	tb->lasttime = glutGet(GLUT_ELAPSED_TIME);
+	tb->lastposition[0] = current_position[0];
+	tb->lastposition[1] = current_position[1];
+	tb->lastposition[2] = current_position[2];
+
+	/* the rotation is applied once, here, however often the matrix is read */
+	_tbRotate(tb);
 
 	/* remember to draw new position */
 	glutPostRedisplay();
@@ -5,33 +5,42 @@
   *
   *
   *  Usage:
-  *  
-  *  o  call gltbInit() in before any other gltb call
-  *  o  call gltbReshape() from the reshape callback
-  *  o  call gltbMatrix() to get the trackball matrix rotation
-  *  o  call gltbStartMotion() to begin trackball movememt
-  *  o  call gltbStopMotion() to stop trackball movememt
-  *  o  call gltbMotion() from the motion callback
-  *  o  call gltbAnimate(GL_TRUE) if you want the trackball to continue 
-  *     spinning after the mouse button has been released
-  *  o  call gltbAnimate(GL_FALSE) if you want the trackball to stop 
+  *
+  *  All the state of a trackball is in a TBtrackball, so each view
+  *  can have its own and nothing is shared between them, not even a
+  *  GLUT idle callback.  The rotation is computed without GL, so only
+  *  tbMatrix() needs a current context.  Reading the matrix changes
+  *  nothing, so a frame can read it any number of times.
+  *
+  *  o  call tbInit() on a trackball before any other tb call
+  *  o  call tbReshape() from the reshape callback
+  *  o  call tbMatrix() to get the trackball matrix rotation
+  *  o  call tbMouse() from the mouse callback to start and stop
+  *     trackball movement
+  *  o  call tbMotion() from the motion callback
+  *  o  call tbAnimate(GL_TRUE) if you want the trackball to continue
+  *     spinning after the mouse button has been released, and
+  *     tbStep() once per frame (from an idle callback, say) to spin it
+  *  o  call tbAnimate(GL_FALSE) if you want the trackball to stop
   *     spinning after the mouse button has been released
   *
   *  Typical setup:
   *
   *
+     TBtrackball trackball;
+
      void
      init(void)
      {
-       gltbInit(GLUT_MIDDLE_BUTTON);
-       gltbAnimate(GL_TRUE);
+       tbInit(&trackball, GLUT_MIDDLE_BUTTON);
+       tbAnimate(&trackball, GL_TRUE);
        . . .
      }
 
      void
      reshape(int width, int height)
      {
-       gltbReshape(width, height);
+       tbReshape(&trackball, width, height);
        . . .
      }
 
@@ -40,7 +49,7 @@
      {
        glPushMatrix();
 
-       gltbMatrix();
+       tbMatrix(&trackball);
        . . . draw the scene . . .
 
        glPopMatrix();
@@ -49,14 +58,22 @@
      void
      mouse(int button, int state, int x, int y)
      {
-       gltbMouse(button, state, x, y);
+       tbMouse(&trackball, button, state, x, y);
        . . .
      }
 
      void
      motion(int x, int y)
      {
-       gltbMotion(x, y);
+       tbMotion(&trackball, x, y);
+       . . .
+     }
+
+     void
+     idle(void)
+     {
+       if (tbStep(&trackball))
+         glutPostRedisplay();
        . . .
      }
 
@@ -69,22 +86,49 @@
        glutDisplayFunc(display);
        glutMouseFunc(mouse);
        glutMotionFunc(motion);
+       glutIdleFunc(idle);
        . . .
      }
   ***/
 
+#ifndef TRACKBALL_H
+#define TRACKBALL_H
+
+#include <GLUT/glut.h>
+
+ /* types */
+ typedef struct _TBtrackball {
+   GLuint    lasttime;          /* GLUT time of the last motion */
+   GLfloat   lastposition[3];   /* last position on the hemi-sphere */
+
+   GLfloat   angle;             /* rotation of the last motion, degrees */
+   GLfloat   axis[3];           /* axis of that rotation */
+   GLfloat   transform[4][4];   /* accumulated rotation, column major */
+
+   GLuint    width;             /* size of the view */
+   GLuint    height;
+
+   GLint     button;            /* button that drags the trackball */
+   GLboolean tracking;          /* the button is held */
+   GLboolean animate;           /* keep spinning after a release */
+   GLboolean spinning;          /* released while moving, tbStep() rotates */
+ } TBtrackball;
+
  /* functions */
- void tbInit(GLuint button);
+ void tbInit(TBtrackball *tb, GLuint button);
+
+ void tbMatrix(TBtrackball *tb);
 
- void tbMatrix(void);
+ void gettbMatrix(TBtrackball *tb, float *m);
 
- void gettbMatrix(float *m);
+ void tbReshape(TBtrackball *tb, int width, int height);
 
- void tbReshape(int width, int height);
+ void tbMouse(TBtrackball *tb, int button, int state, int x, int y);
 
- void tbMouse(int button, int state, int x, int y);
+ void tbMotion(TBtrackball *tb, int x, int y);
 
- void tbMotion(int x, int y);
+ void tbAnimate(TBtrackball *tb, GLboolean animate);
 
- void tbAnimate(GLboolean animate);
+ GLboolean tbStep(TBtrackball *tb);
 
+#endif
@@ -8,6 +8,7 @@ from keras.models import Sequential
 from keras.layers import Dense, Dropout
 from keras import optimizers
 
+import struct
 from os import path
 
 # parameters
@@ -109,11 +110,21 @@ def predict():
     y = model.predict(xpad)
     y = y[:, 16*2:16*3]
     print(y.shape)
+    # the text tracks are kept for compatibility only: they have no
+    # header, so readers take them as smoothed frames 10 ms apart, and
+    # the display reads them only when there is no sequence.bin
     for i, seq in enumerate(y.T):
         with open('sequence' + str(i), 'w') as f:
             smooth_seq = smooth(np.repeat(seq, 4), 11, 'flat')
             for s in smooth_seq:
                 f.write(str(s)+'\n')
 
+    # the raw predictions packed frame after frame, one every 40 ms;
+    # the display smooths them at that rate (see display/sequence.h)
+    frames = np.ascontiguousarray(y, dtype='<f4')
+    with open('sequence.bin', 'wb') as f:
+        f.write(struct.pack('<4sIfIII', b'SQTK', 1, 40.0, frames.shape[1], frames.shape[0], 1).ljust(64, b'\0'))
+        f.write(frames.tobytes())
+
 #adam = optimizers.Adam(lr=1e-6)
 #model.compile(loss='mean_squared_error', optimizer=adam)
\ No newline at end of file